@@ -165,6 +165,21 @@ target_link_libraries(lite-test
 add_test(NAME lite-test
   COMMAND lite-test ${protobuf_GTEST_ARGS})
 
+# Benchmarks are built only when Google Benchmark is installed; they are not
+# registered with ctest.
+find_package(benchmark QUIET)
+if (benchmark_FOUND)
+  add_executable(lazy-packed-field-benchmark
+    ${protobuf_SOURCE_DIR}/src/google/protobuf/lazy_packed_field_benchmark.cc
+    ${protobuf_SOURCE_DIR}/src/google/protobuf/lazy_packed_field_test.pb.cc
+  )
+  target_link_libraries(lazy-packed-field-benchmark
+    ${protobuf_LIB_PROTOBUF}
+    ${protobuf_ABSL_USED_TARGETS}
+    benchmark::benchmark
+  )
+endif()
+
 add_custom_target(check
   COMMAND tests
   DEPENDS tests lite-test test_plugin
@@ -35,8 +35,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <new>
 #include <typeinfo>
 
+#include "absl/numeric/bits.h"
 #include "absl/synchronization/mutex.h"
 #include "google/protobuf/arena_allocation_policy.h"
 #include "google/protobuf/arena_impl.h"
@@ -48,6 +50,12 @@
 #include <sanitizer/asan_interface.h>
 #endif  // ADDRESS_SANITIZER
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
 // Must be included last.
 #include "google/protobuf/port_def.inc"
 
@@ -77,10 +85,208 @@ ArenaBlock* SentryArenaBlock() {
 }
 #endif
 
+// Per-thread free lists of arena blocks, bucketed by power-of-two size class.
+// Arenas created with AllocationPolicy::block_pool_max_bytes return their
+// blocks here on Reset() or destruction, and the next block request of the
+// same size class on this thread is served from the pool instead of the
+// system allocator. This keeps the per-request arena pattern
+// (create, fill, Reset/destroy) from churning malloc for every request.
+class ArenaBlockPool {
+ public:
+  // Blocks outside [2^kMinLog2, 2^kMaxLog2] are never pooled.
+  static constexpr int kMinLog2 = 8;
+  static constexpr int kMaxLog2 = 24;
+
+  ArenaBlockPool() = default;
+  ArenaBlockPool(const ArenaBlockPool&) = delete;
+  ArenaBlockPool& operator=(const ArenaBlockPool&) = delete;
+
+  ~ArenaBlockPool() {
+    for (int i = 0; i < kNumClasses; ++i) {
+      while (FreeBlock* b = free_lists_[i]) {
+        free_lists_[i] = b->next;
+        const size_t size = size_t{1} << (i + kMinLog2);
+#ifdef ADDRESS_SANITIZER
+        ASAN_UNPOISON_MEMORY_REGION(b, size);
+#endif  // ADDRESS_SANITIZER
+        internal::SizedDelete(b, size);
+      }
+    }
+    bytes_ = 0;
+  }
+
+  // Returns the size a block of `size` bytes is allocated with so that it can
+  // be pooled later.
+  static size_t RoundUp(size_t size) {
+    if (size > (size_t{1} << kMaxLog2)) return size;
+    return std::max(size_t{1} << kMinLog2, absl::bit_ceil(size));
+  }
+
+  void* Pop(size_t size) {
+    int cls = SizeClass(size);
+    if (cls < 0) return nullptr;
+    FreeBlock* b = free_lists_[cls];
+    if (b == nullptr) return nullptr;
+    free_lists_[cls] = b->next;
+    bytes_ -= size;
+#ifdef ADDRESS_SANITIZER
+    ASAN_UNPOISON_MEMORY_REGION(b, size);
+#endif  // ADDRESS_SANITIZER
+    return b;
+  }
+
+  // Takes ownership of `mem` and returns true if the pool has room for it
+  // under `max_bytes`; returns false (leaving ownership with the caller)
+  // otherwise.
+  bool Push(void* mem, size_t size, size_t max_bytes) {
+    int cls = SizeClass(size);
+    if (cls < 0 || bytes_ > max_bytes ||
+        size > max_bytes - bytes_) {
+      return false;
+    }
+    FreeBlock* b = static_cast<FreeBlock*>(mem);
+    b->next = free_lists_[cls];
+    free_lists_[cls] = b;
+    bytes_ += size;
+#ifdef ADDRESS_SANITIZER
+    // Catch use-after-Reset of pooled blocks; the header stays accessible.
+    ASAN_POISON_MEMORY_REGION(b + 1, size - sizeof(FreeBlock));
+#endif  // ADDRESS_SANITIZER
+    return true;
+  }
+
+ private:
+  static constexpr int kNumClasses = kMaxLog2 - kMinLog2 + 1;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static int SizeClass(size_t size) {
+    if (size < (size_t{1} << kMinLog2) || size > (size_t{1} << kMaxLog2) ||
+        !absl::has_single_bit(size)) {
+      return -1;
+    }
+    return absl::countr_zero(size) - kMinLog2;
+  }
+
+  FreeBlock* free_lists_[kNumClasses] = {};
+  size_t bytes_ = 0;
+};
+
+#if !defined(GOOGLE_PROTOBUF_NO_THREADLOCAL)
+// The calling thread's pool.  Trivially destructible, so that arenas destroyed
+// by thread-exit destructors running after ThreadBlockPoolOwner's can still
+// read it.
+struct ThreadBlockPoolState {
+  ArenaBlockPool* pool;
+  bool destroyed;
+};
+thread_local ThreadBlockPoolState thread_block_pool_state = {nullptr, false};
+
+// Frees the calling thread's pool on thread exit.
+struct ThreadBlockPoolOwner {
+  ThreadBlockPoolOwner() {
+    thread_block_pool_state.pool = new ArenaBlockPool;
+  }
+  ~ThreadBlockPoolOwner() {
+    delete thread_block_pool_state.pool;
+    thread_block_pool_state.pool = nullptr;
+    thread_block_pool_state.destroyed = true;
+  }
+};
+#endif  // !GOOGLE_PROTOBUF_NO_THREADLOCAL
+
+// Returns nullptr once the calling thread has started to exit and its pool
+// has been freed.
+ArenaBlockPool* ThreadBlockPool() {
+#if defined(GOOGLE_PROTOBUF_NO_THREADLOCAL)
+  return nullptr;
+#else
+  if (thread_block_pool_state.pool == nullptr &&
+      !thread_block_pool_state.destroyed) {
+    static thread_local ThreadBlockPoolOwner owner;
+  }
+  return thread_block_pool_state.pool;
+#endif
+}
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+constexpr bool kHasHugePageBlocks = true;
+
+// Prefers the NUMA node of the calling thread for the pages of [p, p + size).
+// Best effort: kernels without NUMA support simply reject the call.
+void BindToLocalNumaNode(void* p, size_t size) {
+#if defined(SYS_getcpu) && defined(SYS_mbind)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return;
+  constexpr int kMpolPreferred = 1;  // MPOL_PREFERRED from <numaif.h>
+  constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+  unsigned long nodemask[16] = {};
+  if (node >= kBitsPerWord * 16) return;
+  nodemask[node / kBitsPerWord] = 1UL << (node % kBitsPerWord);
+  syscall(SYS_mbind, p, size, kMpolPreferred, nodemask,
+          kBitsPerWord * 16 + 1, 0);
+#else
+  (void)p;
+  (void)size;
+#endif
+}
+
+// Maps `size` bytes, a multiple of kHugePageSize, at a kHugePageSize aligned
+// address so that the whole block can be backed by transparent huge pages.
+void* MapHugePageBlock(size_t size, bool numa_local) {
+  constexpr size_t kHugePageSize = AllocationPolicy::kHugePageSize;
+  // Over-map by one huge page and trim both ends to get the alignment.
+  const size_t map_size = size + kHugePageSize;
+  void* p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  // Report OOM the way the ::operator new path does. The block is released
+  // with UnmapHugePageBlock(), so there is no heap fallback here.
+  if (p == MAP_FAILED) {
+#if PROTOBUF_USE_EXCEPTIONS
+    throw std::bad_alloc();
+#else
+    GOOGLE_LOG(FATAL) << "Failed to map " << map_size << " bytes";
+#endif
+  }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(p);
+  const uintptr_t aligned = (begin + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  if (aligned != begin) munmap(p, aligned - begin);
+  const uintptr_t end = begin + map_size;
+  if (end != aligned + size) {
+    munmap(reinterpret_cast<void*>(aligned + size), end - (aligned + size));
+  }
+  void* block = reinterpret_cast<void*>(aligned);
+  // Transparent huge pages may be disabled system-wide; the mapping still
+  // works with regular pages then.
+  madvise(block, size, MADV_HUGEPAGE);
+  if (numa_local) BindToLocalNumaNode(block, size);
+  return block;
+}
+
+void UnmapHugePageBlock(void* p, size_t size) { munmap(p, size); }
+#else
+constexpr bool kHasHugePageBlocks = false;
+
+void* MapHugePageBlock(size_t, bool) {
+  GOOGLE_LOG(FATAL) << "Huge-page arena blocks are not supported";
+  return nullptr;
+}
+void UnmapHugePageBlock(void*, size_t) {}
+#endif  // __linux__ && MADV_HUGEPAGE
+
+// Whether a block of `size` bytes is (to be) served by MapHugePageBlock().
+bool IsHugePageBlock(const AllocationPolicy& policy, size_t size) {
+  return kHasHugePageBlocks && policy.UsesHugePages() &&
+         size >= AllocationPolicy::kHugePageSize;
+}
+
 }  // namespace
 
 static SerialArena::Memory AllocateMemory(const AllocationPolicy* policy_ptr,
-                                          size_t last_size, size_t min_bytes) {
+                                          size_t last_size, size_t min_bytes,
+                                          ThreadSafeArenaStats* stats = nullptr) {
   AllocationPolicy policy;  // default policy
   if (policy_ptr) policy = *policy_ptr;
   size_t size;
@@ -96,6 +302,22 @@ static SerialArena::Memory AllocateMemory(const AllocationPolicy* policy_ptr,
            std::numeric_limits<size_t>::max() - SerialArena::kBlockHeaderSize);
   size = std::max(size, SerialArena::kBlockHeaderSize + min_bytes);
 
+  if (policy.UsesBlockPool()) {
+    size = ArenaBlockPool::RoundUp(size);
+    if (ArenaBlockPool* pool = ThreadBlockPool()) {
+      if (void* mem = pool->Pop(size)) {
+        ThreadSafeArenaStats::RecordRecycledBlockStats(stats, size);
+        return {mem, size};
+      }
+    }
+  }
+
+  if (IsHugePageBlock(policy, size)) {
+    size = (size + AllocationPolicy::kHugePageSize - 1) &
+           ~(AllocationPolicy::kHugePageSize - 1);
+    return {MapHugePageBlock(size, policy.numa_local_blocks), size};
+  }
+
   void* mem;
   if (policy.block_alloc == nullptr) {
     mem = ::operator new(size);
@@ -109,6 +331,10 @@ class GetDeallocator {
  public:
   GetDeallocator(const AllocationPolicy* policy, size_t* space_allocated)
       : dealloc_(policy ? policy->block_dealloc : nullptr),
+        pool_max_bytes_(policy && policy->UsesBlockPool()
+                            ? policy->block_pool_max_bytes
+                            : 0),
+        huge_pages_(policy && policy->UsesHugePages()),
         space_allocated_(space_allocated) {}
 
   void operator()(SerialArena::Memory mem) const {
@@ -117,6 +343,19 @@ class GetDeallocator {
     // so return it in an unpoisoned state.
     ASAN_UNPOISON_MEMORY_REGION(mem.ptr, mem.size);
 #endif  // ADDRESS_SANITIZER
+    if (pool_max_bytes_ != 0) {
+      ArenaBlockPool* pool = ThreadBlockPool();
+      if (pool != nullptr && pool->Push(mem.ptr, mem.size, pool_max_bytes_)) {
+        *space_allocated_ += mem.size;
+        return;
+      }
+    }
+    if (kHasHugePageBlocks && huge_pages_ &&
+        mem.size >= AllocationPolicy::kHugePageSize) {
+      UnmapHugePageBlock(mem.ptr, mem.size);
+      *space_allocated_ += mem.size;
+      return;
+    }
     if (dealloc_) {
       dealloc_(mem.ptr, mem.size);
     } else {
@@ -127,6 +366,8 @@ class GetDeallocator {
 
  private:
   void (*dealloc_)(void*, size_t);
+  size_t pool_max_bytes_;
+  bool huge_pages_;
   size_t* space_allocated_;
 };
 
@@ -228,7 +469,8 @@ void SerialArena::AllocateNewBlock(size_t n) {
   // but with a CPU regression. The regression might have been an artifact of
   // the microbenchmark.
 
-  auto mem = AllocateMemory(parent_.AllocPolicy(), old_head->size, n);
+  auto mem = AllocateMemory(parent_.AllocPolicy(), old_head->size, n,
+                            parent_.arena_stats_.MutableStats());
   // We don't want to emit an expensive RMW instruction that requires
   // exclusive access to a cacheline. Hence we write it in terms of a
   // regular add.
@@ -873,7 +1115,9 @@ SerialArena* ThreadSafeArena::GetSerialArenaFallback(size_t n) {
     // have any blocks yet.  So we'll allocate its first block now. It must be
     // big enough to host SerialArena and the pending request.
     serial = SerialArena::New(
-        AllocateMemory(alloc_policy_.get(), 0, n + kSerialArenaSize), *this);
+        AllocateMemory(alloc_policy_.get(), 0, n + kSerialArenaSize,
+                       arena_stats_.MutableStats()),
+        *this);
 
     AddSerialArena(id, serial);
   }
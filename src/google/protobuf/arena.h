@@ -142,6 +142,28 @@ struct ArenaOptions {
   // calls free.
   void (*block_dealloc)(void*, size_t) = nullptr;
 
+  // If non-zero, blocks released by Reset() or by the arena's destruction are
+  // kept in a per-thread pool (up to this many bytes per thread) and handed
+  // back to the next arena on the same thread that needs a block of that size,
+  // instead of being returned to the system allocator. Block sizes are rounded
+  // up to powers of two when pooling is enabled. Ignored when block_alloc or
+  // block_dealloc is set, or on platforms without thread-local storage.
+  size_t block_pool_max_bytes = 0;
+
+  // If true, blocks of 2MB or more are mapped directly from the OS, aligned to
+  // and rounded up to 2MB, and advised as transparent huge pages. This cuts
+  // TLB misses for long-lived arenas holding large message graphs; set
+  // max_block_size to 2MB or more so that the arena actually grows into such
+  // blocks. Smaller blocks use the default allocator. Linux only; ignored
+  // elsewhere and when block_alloc or block_dealloc is set. Disables
+  // block_pool_max_bytes.
+  bool huge_page_blocks = false;
+
+  // If true (together with huge_page_blocks), huge-page blocks are bound to
+  // the NUMA node of the thread that allocates them. Has no effect unless
+  // huge_page_blocks is also set.
+  bool numa_local_blocks = false;
+
  private:
   internal::AllocationPolicy AllocationPolicy() const {
     internal::AllocationPolicy res;
@@ -149,6 +171,9 @@ struct ArenaOptions {
     res.max_block_size = max_block_size;
     res.block_alloc = block_alloc;
     res.block_dealloc = block_dealloc;
+    res.block_pool_max_bytes = block_pool_max_bytes;
+    res.huge_page_blocks = huge_page_blocks;
+    res.numa_local_blocks = numa_local_blocks;
     return res;
   }
 
@@ -54,10 +54,36 @@ struct AllocationPolicy {
   void* (*block_alloc)(size_t) = nullptr;
   void (*block_dealloc)(void*, size_t) = nullptr;
 
+  // Upper bound on the bytes of freed blocks kept in the per-thread block pool
+  // for reuse by later arenas on the same thread. Zero disables pooling.
+  size_t block_pool_max_bytes = 0;
+
+  // Blocks of at least kHugePageSize bytes are mapped directly from the OS,
+  // aligned to and rounded up to kHugePageSize, and advised as transparent
+  // huge pages. Only supported on Linux.
+  static constexpr size_t kHugePageSize = size_t{2} << 20;
+  bool huge_page_blocks = false;
+  // Binds huge-page blocks to the NUMA node of the allocating thread.
+  bool numa_local_blocks = false;
+
   bool IsDefault() const {
     return start_block_size == kDefaultStartBlockSize &&
            max_block_size == GetDefaultArenaMaxBlockSize() &&
-           block_alloc == nullptr && block_dealloc == nullptr;
+           block_alloc == nullptr && block_dealloc == nullptr &&
+           block_pool_max_bytes == 0 && !huge_page_blocks &&
+           !numa_local_blocks;
+  }
+
+  // Built-in allocation strategies only apply to blocks obtained from the
+  // default allocator; a custom block_alloc / block_dealloc pair owns its own
+  // memory.
+  bool UsesHugePages() const {
+    return huge_page_blocks && block_alloc == nullptr &&
+           block_dealloc == nullptr;
+  }
+  bool UsesBlockPool() const {
+    return block_pool_max_bytes != 0 && block_alloc == nullptr &&
+           block_dealloc == nullptr && !huge_page_blocks;
   }
 };
 
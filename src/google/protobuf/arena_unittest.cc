@@ -35,6 +35,7 @@
 #include <cstring>
 #include <memory>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <typeinfo>
 #include <vector>
@@ -1410,6 +1411,85 @@ TEST(ArenaTest, SpaceAllocated_and_Used) {
   EXPECT_EQ(1024, arena_2.Reset());
 }
 
+#if !defined(GOOGLE_PROTOBUF_NO_THREADLOCAL)
+TEST(ArenaTest, BlockPoolRecyclesBlocksOnReset) {
+  ArenaOptions options;
+  options.block_pool_max_bytes = 1 << 20;
+  Arena arena(options);
+
+  // Force a second block; the first one also holds the allocation policy.
+  char* p = Arena::CreateArray<char>(&arena, 4000);
+  const uint64_t space_allocated = arena.SpaceAllocated();
+  EXPECT_EQ(space_allocated, arena.Reset());
+
+  // The released block comes back from this thread's pool.
+  EXPECT_EQ(p, Arena::CreateArray<char>(&arena, 4000));
+  EXPECT_EQ(space_allocated, arena.SpaceAllocated());
+}
+
+TEST(ArenaTest, BlockPoolRecyclesBlocksAcrossArenas) {
+  ArenaOptions options;
+  options.block_pool_max_bytes = 1 << 20;
+  char* p;
+  {
+    Arena arena(options);
+    p = Arena::CreateArray<char>(&arena, 4000);
+  }
+  Arena arena(options);
+  EXPECT_EQ(p, Arena::CreateArray<char>(&arena, 4000));
+}
+
+TEST(ArenaTest, BlockPoolRespectsLimit) {
+  ArenaOptions options;
+  // Too small to hold any block, so everything goes back to the allocator.
+  options.block_pool_max_bytes = 64;
+  Arena arena(options);
+  for (int i = 0; i < 4; ++i) {
+    Arena::CreateArray<char>(&arena, 4000);
+    EXPECT_LE(4000, arena.Reset());
+  }
+}
+
+TEST(ArenaTest, BlockPoolArenaDestroyedAtThreadExit) {
+  std::thread([] {
+    // Constructed before this thread's block pool, so destroyed after it.
+    static thread_local std::unique_ptr<Arena> arena;
+    ArenaOptions options;
+    options.block_pool_max_bytes = 1 << 20;
+    arena = std::make_unique<Arena>(options);
+    Arena::CreateArray<char>(arena.get(), 4000);
+  }).join();
+}
+#endif  // !GOOGLE_PROTOBUF_NO_THREADLOCAL
+
+#if defined(__linux__)
+TEST(ArenaTest, HugePageBlocks) {
+  constexpr size_t kHugePageSize = internal::AllocationPolicy::kHugePageSize;
+  for (bool numa_local : {false, true}) {
+    ArenaOptions options;
+    options.max_block_size = 4 * kHugePageSize;
+    options.huge_page_blocks = true;
+    options.numa_local_blocks = numa_local;
+    Arena arena(options);
+
+    Arena::CreateArray<char>(&arena, 1);
+    const uint64_t first_block = arena.SpaceAllocated();
+    constexpr size_t kSize = kHugePageSize + kHugePageSize / 2;
+    char* p = Arena::CreateArray<char>(&arena, kSize);
+    memset(p, 0xcd, kSize);
+    // The large block starts on a huge page and is a whole number of them.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % kHugePageSize,
+              internal::SerialArena::kBlockHeaderSize);
+    EXPECT_EQ(2 * kHugePageSize, arena.SpaceAllocated() - first_block);
+    EXPECT_EQ(first_block + 2 * kHugePageSize, arena.Reset());
+
+    // Arenas reuse their first, regular block after Reset.
+    Arena::CreateArray<char>(&arena, 1);
+    EXPECT_EQ(first_block, arena.SpaceAllocated());
+  }
+}
+#endif  // __linux__
+
 namespace {
 
 void VerifyArenaOverhead(Arena& arena, size_t overhead) {
@@ -86,6 +86,8 @@ void ThreadSafeArenaStats::PrepareForSampling(int64_t stride) {
   for (auto& blockstats : block_histogram) blockstats.PrepareForSampling();
   max_block_size.store(0, std::memory_order_relaxed);
   thread_ids.store(0, std::memory_order_relaxed);
+  num_recycled_blocks.store(0, std::memory_order_relaxed);
+  bytes_recycled.store(0, std::memory_order_relaxed);
   weight = stride;
   // The inliner makes hardcoded skip_count difficult (especially when combined
   // with LTO).  We use the ability to exclude stacks by regex when encoding
@@ -135,6 +137,11 @@ void RecordAllocateSlow(ThreadSafeArenaStats* info, size_t used,
   info->thread_ids.fetch_or(tid, std::memory_order_relaxed);
 }
 
+void RecordRecycledBlockSlow(ThreadSafeArenaStats* info, size_t size) {
+  info->num_recycled_blocks.fetch_add(1, std::memory_order_relaxed);
+  info->bytes_recycled.fetch_add(size, std::memory_order_relaxed);
+}
+
 ThreadSafeArenaStats* SampleSlow(SamplingState& sampling_state) {
   bool first = sampling_state.next_sample < 0;
   const int64_t next_stride = g_exponential_biased_generator.GetStride(
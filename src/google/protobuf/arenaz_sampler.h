@@ -49,6 +49,7 @@ namespace internal {
 struct ThreadSafeArenaStats;
 void RecordAllocateSlow(ThreadSafeArenaStats* info, size_t used,
                         size_t allocated, size_t wasted);
+void RecordRecycledBlockSlow(ThreadSafeArenaStats* info, size_t size);
 // Stores information about a sampled thread safe arena.  All mutations to this
 // *must* be made through `Record*` functions below.  All reads from this *must*
 // only occur in the callback to `ThreadSafeArenazSampler::Iterate`.
@@ -96,6 +97,10 @@ struct ThreadSafeArenaStats
   // bit mixing for thread-ids; `% 64` would only grab the low bits and might
   // create sampling artifacts.
   std::atomic<uint64_t> thread_ids;
+  // Blocks that were served from the per-thread block pool rather than the
+  // system allocator, and their total size.
+  std::atomic<int> num_recycled_blocks;
+  std::atomic<size_t> bytes_recycled;
 
   // All of the fields below are set by `PrepareForSampling`, they must not
   // be mutated in `Record*` functions.  They are logically `const` in that
@@ -110,6 +115,11 @@ struct ThreadSafeArenaStats
     if (PROTOBUF_PREDICT_TRUE(info == nullptr)) return;
     RecordAllocateSlow(info, used, allocated, wasted);
   }
+  static void RecordRecycledBlockStats(ThreadSafeArenaStats* info,
+                                       size_t size) {
+    if (PROTOBUF_PREDICT_TRUE(info == nullptr)) return;
+    RecordRecycledBlockSlow(info, size);
+  }
 
   // Returns the bin for the provided size.
   static size_t FindBin(size_t bytes);
@@ -190,6 +200,8 @@ using SamplingState = int64_t;
 struct ThreadSafeArenaStats {
   static void RecordAllocateStats(ThreadSafeArenaStats*, size_t /*requested*/,
                                   size_t /*allocated*/, size_t /*wasted*/) {}
+  static void RecordRecycledBlockStats(ThreadSafeArenaStats*,
+                                       size_t /*size*/) {}
 };
 
 ThreadSafeArenaStats* SampleSlow(SamplingState& next_sample);
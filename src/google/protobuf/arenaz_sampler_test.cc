@@ -190,6 +190,21 @@ TEST(ThreadSafeArenaStatsTest, RecordAllocateSlow) {
   EXPECT_EQ(info.max_block_size.load(std::memory_order_relaxed), 256);
 }
 
+TEST(ThreadSafeArenaStatsTest, RecordRecycledBlockSlow) {
+  ThreadSafeArenaStats info;
+  constexpr int64_t kTestStride = 458;
+  absl::MutexLock l(&info.init_mu);
+  info.PrepareForSampling(kTestStride);
+  RecordRecycledBlockSlow(&info, /*size=*/4096);
+  RecordRecycledBlockSlow(&info, /*size=*/512);
+  EXPECT_EQ(info.num_recycled_blocks.load(std::memory_order_relaxed), 2);
+  EXPECT_EQ(info.bytes_recycled.load(std::memory_order_relaxed), 4608);
+
+  info.PrepareForSampling(kTestStride);
+  EXPECT_EQ(info.num_recycled_blocks.load(std::memory_order_relaxed), 0);
+  EXPECT_EQ(info.bytes_recycled.load(std::memory_order_relaxed), 0);
+}
+
 TEST(ThreadSafeArenaStatsTest, RecordAllocateSlowMaxBlockSizeTest) {
   ThreadSafeArenaStats info;
   constexpr int64_t kTestStride = 458;
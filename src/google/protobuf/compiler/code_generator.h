@@ -123,6 +123,14 @@ class PROTOC_EXPORT CodeGenerator {
   // version of the library. When protobufs does a api breaking change, the
   // method can be removed.
   virtual bool HasGenerateAll() const { return true; }
+
+  // Returns true if Generate() may be called for different files at the same
+  // time, from different threads.  protoc's --jobs flag generates the files
+  // of such generators in parallel, each into its own GeneratorContext whose
+  // writes are then applied in file order, so the output is the same as that
+  // of GenerateAll().  Generators which return true must not override
+  // GenerateAll().
+  virtual bool SupportsParallelGeneration() const { return false; }
 };
 
 // CodeGenerators generate one or more files in a given directory.  This
@@ -179,6 +187,12 @@ class PROTOC_EXPORT GeneratorContext {
   // this GeneratorContext.
   virtual void GetCompilerVersion(Version* version) const;
 
+  // Returns the number of threads the generator may use to generate a file,
+  // as set by protoc's --jobs flag.  Always at least 1.  A generator that
+  // uses more than one thread must still call the methods of this
+  // GeneratorContext from the thread which called it, in a deterministic
+  // order.
+  virtual int GetJobs() const { return 1; }
 };
 
 // The type GeneratorContext was once called OutputDirectory. This typedef
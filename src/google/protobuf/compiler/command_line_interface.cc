@@ -61,8 +61,11 @@
 
 #include <limits.h>  // For PATH_MAX
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -78,6 +81,7 @@
 #include "google/protobuf/compiler/plugin.pb.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_replace.h"
 #include "absl/strings/str_split.h"
@@ -396,6 +400,9 @@ class CommandLineInterface::GeneratorContextImpl : public GeneratorContext {
  public:
   GeneratorContextImpl(const std::vector<const FileDescriptor*>& parsed_files);
 
+  // Sets the value returned by GetJobs().
+  void set_jobs(int jobs) { jobs_ = jobs; }
+
   // Write all files in the directory to disk at the given output location,
   // which must end in a '/'.
   bool WriteAllToDisk(const std::string& prefix);
@@ -421,6 +428,7 @@ class CommandLineInterface::GeneratorContextImpl : public GeneratorContext {
   void ListParsedFiles(std::vector<const FileDescriptor*>* output) override {
     *output = parsed_files_;
   }
+  int GetJobs() const override { return jobs_; }
 
  private:
   friend class MemoryOutputStream;
@@ -431,6 +439,7 @@ class CommandLineInterface::GeneratorContextImpl : public GeneratorContext {
   absl::btree_map<std::string, std::string> files_;
   const std::vector<const FileDescriptor*>& parsed_files_;
   bool had_error_;
+  int jobs_ = 1;
 };
 
 class CommandLineInterface::MemoryOutputStream
@@ -897,6 +906,117 @@ CommandLineInterface::MemoryOutputStream::~MemoryOutputStream() {
   UpdateMetadata(data_, pos, data_.size() + indent_size, indent_.size());
 }
 
+// -------------------------------------------------------------------
+
+// A GeneratorContext for generating a single file on a worker thread.  It
+// records the writes made through it, which are applied to the shared
+// GeneratorContext once all files have been generated.  Since
+// GeneratorContextImpl applies the writes of a stream when the stream is
+// destroyed, replaying each recorded stream in the order in which it was
+// destroyed produces the same output as generating into the shared context
+// directly.
+class CommandLineInterface::RecordingGeneratorContext
+    : public GeneratorContext {
+ public:
+  RecordingGeneratorContext(GeneratorContext* parent, int jobs)
+      : parent_(parent), jobs_(jobs) {}
+
+  // Applies the recorded writes to the parent context.
+  void Replay();
+
+  // implements GeneratorContext --------------------------------------
+  io::ZeroCopyOutputStream* Open(const std::string& filename) override {
+    return new RecordingOutputStream(this, {Write::kOpen, filename});
+  }
+  io::ZeroCopyOutputStream* OpenForAppend(
+      const std::string& filename) override {
+    return new RecordingOutputStream(this, {Write::kAppend, filename});
+  }
+  io::ZeroCopyOutputStream* OpenForInsert(
+      const std::string& filename,
+      const std::string& insertion_point) override {
+    return new RecordingOutputStream(
+        this, {Write::kInsert, filename, insertion_point});
+  }
+  io::ZeroCopyOutputStream* OpenForInsertWithGeneratedCodeInfo(
+      const std::string& filename, const std::string& insertion_point,
+      const google::protobuf::GeneratedCodeInfo& info) override {
+    return new RecordingOutputStream(
+        this, {Write::kInsertWithInfo, filename, insertion_point, info});
+  }
+  void ListParsedFiles(std::vector<const FileDescriptor*>* output) override {
+    parent_->ListParsedFiles(output);
+  }
+  void GetCompilerVersion(Version* version) const override {
+    parent_->GetCompilerVersion(version);
+  }
+  int GetJobs() const override { return jobs_; }
+
+ private:
+  struct Write {
+    enum Kind { kOpen, kAppend, kInsert, kInsertWithInfo };
+    Kind kind;
+    std::string filename;
+    std::string insertion_point;
+    GeneratedCodeInfo info;
+    std::string data;
+  };
+
+  class RecordingOutputStream : public io::ZeroCopyOutputStream {
+   public:
+    RecordingOutputStream(RecordingGeneratorContext* context, Write write)
+        : context_(context),
+          write_(std::move(write)),
+          inner_(new io::StringOutputStream(&write_.data)) {}
+    ~RecordingOutputStream() override {
+      // Make sure all data has been written.
+      inner_.reset();
+      context_->writes_.push_back(std::move(write_));
+    }
+
+    // implements ZeroCopyOutputStream -------------------------------
+    bool Next(void** data, int* size) override {
+      return inner_->Next(data, size);
+    }
+    void BackUp(int count) override { inner_->BackUp(count); }
+    int64_t ByteCount() const override { return inner_->ByteCount(); }
+
+   private:
+    RecordingGeneratorContext* context_;
+    Write write_;
+    std::unique_ptr<io::StringOutputStream> inner_;
+  };
+
+  GeneratorContext* parent_;
+  int jobs_;
+  // In the order in which their streams were destroyed.
+  std::vector<Write> writes_;
+};
+
+void CommandLineInterface::RecordingGeneratorContext::Replay() {
+  for (const Write& write : writes_) {
+    std::unique_ptr<io::ZeroCopyOutputStream> output;
+    switch (write.kind) {
+      case Write::kOpen:
+        output.reset(parent_->Open(write.filename));
+        break;
+      case Write::kAppend:
+        output.reset(parent_->OpenForAppend(write.filename));
+        break;
+      case Write::kInsert:
+        output.reset(
+            parent_->OpenForInsert(write.filename, write.insertion_point));
+        break;
+      case Write::kInsertWithInfo:
+        output.reset(parent_->OpenForInsertWithGeneratedCodeInfo(
+            write.filename, write.insertion_point, write.info));
+        break;
+    }
+    io::CodedOutputStream(output.get()).WriteString(write.data);
+  }
+  writes_.clear();
+}
+
 // ===================================================================
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -1078,6 +1198,7 @@ int CommandLineInterface::Run(int argc, const char* const argv[]) {
       if (!generator) {
         // First time we've seen this output location.
         generator = std::make_unique<GeneratorContextImpl>(parsed_files);
+        generator->set_jobs(jobs_);
       }
 
       if (!GenerateOutput(parsed_files, output_directives_[i],
@@ -1343,6 +1464,7 @@ void CommandLineInterface::Clear() {
   disallow_services_ = false;
   direct_dependencies_explicitly_set_ = false;
   deterministic_output_ = false;
+  jobs_ = 1;
 }
 
 bool CommandLineInterface::MakeProtoProtoPathRelative(
@@ -1907,6 +2029,11 @@ CommandLineInterface::InterpretArgument(const std::string& name,
       return PARSE_ARGUMENT_FAIL;
     }
     fatal_warnings_ = true;
+  } else if (name == "--jobs") {
+    if (!absl::SimpleAtoi(value, &jobs_) || jobs_ < 1) {
+      std::cerr << "Invalid value for --jobs: " << value << std::endl;
+      return PARSE_ARGUMENT_FAIL;
+    }
   } else if (name == "--plugin") {
     if (plugin_prefix_.empty()) {
       std::cerr << "This compiler does not support plugins." << std::endl;
@@ -2086,6 +2213,10 @@ Parse PROTO_FILES and generate output based on the options given:
                               gcc). This flag will make protoc return
                               with a non-zero exit code if any warnings
                               are generated.
+  --jobs=N                    Run code generators on up to N threads.
+                              Generators which support it generate
+                              several files at once; the output is the
+                              same as with a single thread.
   --print_free_field_numbers  Print the free field numbers of the messages
                               defined in the given proto files. Groups share
                               the same field number space with the parent
@@ -2195,8 +2326,17 @@ bool CommandLineInterface::GenerateOutput(
       return false;
     }
 
-    if (!output_directive.generator->GenerateAll(parsed_files, parameters,
-                                                 generator_context, &error)) {
+    const CodeGenerator* generator = output_directive.generator;
+    bool succeeded;
+    if (jobs_ > 1 && parsed_files.size() > 1 &&
+        generator->SupportsParallelGeneration()) {
+      succeeded = GenerateAllParallel(parsed_files, generator, parameters,
+                                      generator_context, &error);
+    } else {
+      succeeded = generator->GenerateAll(parsed_files, parameters,
+                                         generator_context, &error);
+    }
+    if (!succeeded) {
       // Generator returned an error.
       std::cerr << output_directive.name << ": " << error << std::endl;
       return false;
@@ -2206,6 +2346,60 @@ bool CommandLineInterface::GenerateOutput(
   return true;
 }
 
+bool CommandLineInterface::GenerateAllParallel(
+    const std::vector<const FileDescriptor*>& parsed_files,
+    const CodeGenerator* generator, const std::string& parameter,
+    GeneratorContext* generator_context, std::string* error) {
+  const int num_files = static_cast<int>(parsed_files.size());
+  const int num_threads = std::min(jobs_, num_files);
+  // Threads left over after one per file are shared out for generators to
+  // use within a file.
+  const int jobs_per_file = std::max(1, jobs_ / num_threads);
+
+  std::vector<std::unique_ptr<RecordingGeneratorContext>> contexts;
+  for (int i = 0; i < num_files; i++) {
+    contexts.push_back(std::make_unique<RecordingGeneratorContext>(
+        generator_context, jobs_per_file));
+  }
+  std::unique_ptr<bool[]> succeeded(new bool[num_files]);
+  std::vector<std::string> errors(num_files);
+
+  std::atomic<int> next_file{0};
+  auto generate = [&] {
+    for (int i; (i = next_file.fetch_add(1)) < num_files;) {
+      succeeded[i] = generator->Generate(parsed_files[i], parameter,
+                                         contexts[i].get(), &errors[i]);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++) {
+    threads.emplace_back(generate);
+  }
+  generate();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  // Apply the writes in file order, stopping at the first error, like
+  // CodeGenerator::GenerateAll() does.
+  for (int i = 0; i < num_files; i++) {
+    contexts[i]->Replay();
+    if (!succeeded[i] && errors[i].empty()) {
+      errors[i] =
+          "Code generator returned false but provided no error "
+          "description.";
+    }
+    if (!errors[i].empty()) {
+      *error = parsed_files[i]->name() + ": " + errors[i];
+      return succeeded[i];
+    }
+    if (!succeeded[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool CommandLineInterface::GenerateDependencyManifestFile(
     const std::vector<const FileDescriptor*>& parsed_files,
     const GeneratorContextMap& output_directories,
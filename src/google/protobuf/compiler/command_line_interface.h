@@ -215,6 +215,7 @@ class PROTOC_EXPORT CommandLineInterface {
   class ErrorPrinter;
   class GeneratorContextImpl;
   class MemoryOutputStream;
+  class RecordingGeneratorContext;
   using GeneratorContextMap =
       absl::flat_hash_map<std::string, std::unique_ptr<GeneratorContextImpl>>;
 
@@ -291,6 +292,12 @@ class PROTOC_EXPORT CommandLineInterface {
   bool GenerateOutput(const std::vector<const FileDescriptor*>& parsed_files,
                       const OutputDirective& output_directive,
                       GeneratorContext* generator_context);
+  // Like CodeGenerator::GenerateAll(), but generates the files on up to
+  // jobs_ threads.  Only used for generators which support it.
+  bool GenerateAllParallel(
+      const std::vector<const FileDescriptor*>& parsed_files,
+      const CodeGenerator* generator, const std::string& parameter,
+      GeneratorContext* generator_context, std::string* error);
   bool GeneratePluginOutput(
       const std::vector<const FileDescriptor*>& parsed_files,
       const std::string& plugin_name, const std::string& parameter,
@@ -457,6 +464,9 @@ class PROTOC_EXPORT CommandLineInterface {
 
   // When using --encode, this will be passed to SetSerializationDeterministic.
   bool deterministic_output_ = false;
+
+  // The number of threads code generators may use, set by --jobs.
+  int jobs_ = 1;
 };
 
 }  // namespace compiler
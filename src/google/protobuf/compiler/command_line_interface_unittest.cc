@@ -220,6 +220,9 @@ class CommandLineInterfaceTest : public testing::Test {
   void ExpectFileContent(const std::string& filename,
                          const std::string& content);
 
+  // Returns the contents of the given file within temp_directory_.
+  std::string ReadTempFile(const std::string& filename);
+
   // The default code generators support all features. Use this to create a
   // code generator that omits the given feature(s).
   void CreateGeneratorWithMissingFeatures(const std::string& name,
@@ -545,6 +548,14 @@ void CommandLineInterfaceTest::ExpectFileContent(const std::string& filename,
             file_contents);
 }
 
+std::string CommandLineInterfaceTest::ReadTempFile(
+    const std::string& filename) {
+  std::string path = temp_directory_ + "/" + filename;
+  std::string file_contents;
+  GOOGLE_CHECK_OK(File::GetContents(path, &file_contents, true));
+  return file_contents;
+}
+
 // ===================================================================
 
 TEST_F(CommandLineInterfaceTest, BasicOutput) {
@@ -1227,6 +1238,69 @@ TEST_F(CommandLineInterfaceTest, InsertWithAnnotationFixup) {
   CheckGeneratedAnnotations("test_plugin", "foo.proto");
 }
 
+TEST_F(CommandLineInterfaceTest, MultipleInputsWithJobs) {
+  // Test generating several files in parallel.
+
+  CreateTempFile("foo.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Foo {}\n");
+  CreateTempFile("bar.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Bar {}\n");
+  CreateTempFile("baz.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Baz {}\n");
+
+  Run("protocol_compiler --jobs=2 --test_out=$tmpdir --plug_out=$tmpdir "
+      "--proto_path=$tmpdir foo.proto bar.proto baz.proto");
+
+  ExpectNoErrors();
+  ExpectGeneratedWithMultipleInputs("test_generator",
+                                    "foo.proto,bar.proto,baz.proto",
+                                    "foo.proto", "Foo");
+  ExpectGeneratedWithMultipleInputs("test_generator",
+                                    "foo.proto,bar.proto,baz.proto",
+                                    "bar.proto", "Bar");
+  ExpectGeneratedWithMultipleInputs("test_generator",
+                                    "foo.proto,bar.proto,baz.proto",
+                                    "baz.proto", "Baz");
+  ExpectGeneratedWithMultipleInputs("test_plugin",
+                                    "foo.proto,bar.proto,baz.proto",
+                                    "foo.proto", "Foo");
+}
+
+TEST_F(CommandLineInterfaceTest, InsertWithJobs) {
+  // Test that files generated in parallel are written in the same order as
+  // without --jobs, so that insertions give the same output.
+
+  CreateTempFile("foo.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Foo {}\n");
+  CreateTempFile("bar.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Bar {}\n");
+  CreateTempDir("serial");
+  CreateTempDir("parallel");
+
+  Run("protocol_compiler "
+      "--test_out=TestParameter:$tmpdir/serial "
+      "--test_out=insert=test_generator:$tmpdir/serial "
+      "--proto_path=$tmpdir foo.proto bar.proto");
+  ExpectNoErrors();
+  Run("protocol_compiler --jobs=4 "
+      "--test_out=TestParameter:$tmpdir/parallel "
+      "--test_out=insert=test_generator:$tmpdir/parallel "
+      "--proto_path=$tmpdir foo.proto bar.proto");
+  ExpectNoErrors();
+
+  for (const char* proto_name : {"foo.proto", "bar.proto"}) {
+    std::string filename =
+        MockCodeGenerator::GetOutputFileName("test_generator", proto_name);
+    EXPECT_EQ(ReadTempFile("serial/" + filename),
+              ReadTempFile("parallel/" + filename));
+  }
+}
+
 #if defined(_WIN32)
 
 TEST_F(CommandLineInterfaceTest, WindowsOutputPath) {
@@ -2174,6 +2248,32 @@ TEST_F(CommandLineInterfaceTest, GeneratorError) {
       "--test_out: foo.proto: Saw message type MockCodeGenerator_Error.");
 }
 
+TEST_F(CommandLineInterfaceTest, GeneratorErrorWithJobs) {
+  CreateTempFile("foo.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Foo {}\n");
+  CreateTempFile("bar.proto",
+                 "syntax = \"proto2\";\n"
+                 "message MockCodeGenerator_Error {}\n");
+
+  Run("protocol_compiler --jobs=2 --test_out=$tmpdir "
+      "--proto_path=$tmpdir foo.proto bar.proto");
+
+  ExpectErrorSubstring(
+      "--test_out: bar.proto: Saw message type MockCodeGenerator_Error.");
+}
+
+TEST_F(CommandLineInterfaceTest, InvalidJobs) {
+  CreateTempFile("foo.proto",
+                 "syntax = \"proto2\";\n"
+                 "message Foo {}\n");
+
+  Run("protocol_compiler --jobs=0 --test_out=$tmpdir "
+      "--proto_path=$tmpdir foo.proto");
+
+  ExpectErrorText("Invalid value for --jobs: 0\n");
+}
+
 TEST_F(CommandLineInterfaceTest, GeneratorPluginError) {
   // Test a generator plugin that returns an error.
 
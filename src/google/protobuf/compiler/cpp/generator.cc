@@ -34,18 +34,24 @@
 
 #include "google/protobuf/compiler/cpp/generator.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "google/protobuf/compiler/cpp/file.h"
 #include "google/protobuf/compiler/cpp/helpers.h"
+#include "google/protobuf/compiler/cpp/lazy_pack_profile.h"
 #include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 
 namespace google {
 namespace protobuf {
@@ -122,7 +128,17 @@ bool CppGenerator::Generate(const FileDescriptor* file,
   //
   // If the lite option is passed to the compiler, we will generate the
   // current files and all transitive dependencies using the LITE runtime.
+  //
+  // If the lazy_pack_profile option names a field access profile (see
+  // lazy_pack_profile.h), message fields which the profile shows are rarely
+  // read after parsing are generated as if marked [lazy_pack = true], and the
+  // choices are written to <basename>.lazy_pack_report.txt.  The thresholds
+  // are set with lazy_pack_max_access_ratio (default 0.05) and
+  // lazy_pack_min_parses (default 1000).  Note that lazy fields have
+  // different accessor types, so code using the generated classes has to
+  // expect the chosen fields to be lazy.
   Options file_options;
+  LazyPackProfile lazy_pack_profile;
 
   file_options.opensource_runtime = opensource_runtime_;
   file_options.runtime_include_base = runtime_include_base_;
@@ -178,6 +194,21 @@ bool CppGenerator::Generate(const FileDescriptor* file,
       file_options.message_owned_arena_trial = true;
     } else if (key == "force_eagerly_verified_lazy") {
       file_options.force_eagerly_verified_lazy = true;
+    } else if (key == "lazy_pack_profile") {
+      if (!lazy_pack_profile.Load(value, error)) {
+        return false;
+      }
+      file_options.lazy_pack_profile = &lazy_pack_profile;
+    } else if (key == "lazy_pack_max_access_ratio") {
+      if (!absl::SimpleAtod(value, &file_options.lazy_pack_max_access_ratio)) {
+        *error = "Invalid value for lazy_pack_max_access_ratio: " + value;
+        return false;
+      }
+    } else if (key == "lazy_pack_min_parses") {
+      if (!absl::SimpleAtoi(value, &file_options.lazy_pack_min_parses)) {
+        *error = "Invalid value for lazy_pack_min_parses: " + value;
+        return false;
+      }
     } else if (key == "experimental_tail_call_table_mode") {
       if (value == "never") {
         file_options.tctable_mode = Options::kTCTableNever;
@@ -305,23 +336,54 @@ bool CppGenerator::Generate(const FileDescriptor* file,
       num_cc_files = file_options.num_cc_files;
     }
 
-    int cc_file_number = 0;
-    for (int i = 0; i < file_generator.NumMessages(); ++i) {
-      auto output = absl::WrapUnique(generator_context->Open(
-          NumberedCcFileName(basename, cc_file_number++)));
-      io::Printer p(output.get());
+    // Render the message and extension files into memory, on several
+    // threads if allowed, then write them out in order.
+    std::vector<std::string> cc_files(file_generator.NumMessages() +
+                                      file_generator.NumExtensions());
+    auto generate_cc_file = [&](FileGenerator& generator, int i) {
+      io::StringOutputStream output(&cc_files[i]);
+      io::Printer p(&output);
       auto v = p.WithVars(CommonVars(file_options));
 
-      file_generator.GenerateSourceForMessage(i, &p);
+      if (i < generator.NumMessages()) {
+        generator.GenerateSourceForMessage(i, &p);
+      } else {
+        generator.GenerateSourceForExtension(i - generator.NumMessages(), &p);
+      }
+    };
+    const int num_rendered = static_cast<int>(cc_files.size());
+    int jobs = std::min(generator_context->GetJobs(), num_rendered);
+    if (jobs <= 1) {
+      for (int i = 0; i < num_rendered; ++i) {
+        generate_cc_file(file_generator, i);
+      }
+    } else {
+      std::atomic<int> next_cc_file{0};
+      auto generate_cc_files = [&](FileGenerator& generator) {
+        for (int i; (i = next_cc_file.fetch_add(1)) < num_rendered;) {
+          generate_cc_file(generator, i);
+        }
+      };
+      // FileGenerator caches analysis results while generating, so every
+      // other thread needs its own.
+      std::vector<std::thread> threads;
+      for (int i = 1; i < jobs; ++i) {
+        threads.emplace_back([&] {
+          FileGenerator generator(file, file_options);
+          generate_cc_files(generator);
+        });
+      }
+      generate_cc_files(file_generator);
+      for (std::thread& thread : threads) {
+        thread.join();
+      }
     }
 
-    for (int i = 0; i < file_generator.NumExtensions(); ++i) {
+    int cc_file_number = 0;
+    for (const std::string& cc_file : cc_files) {
       auto output = absl::WrapUnique(generator_context->Open(
           NumberedCcFileName(basename, cc_file_number++)));
-      io::Printer p(output.get());
-      auto v = p.WithVars(CommonVars(file_options));
-
-      file_generator.GenerateSourceForExtension(i, &p);
+      io::Printer(output.get()).PrintRaw(cc_file);
     }
 
     // Create empty placeholder files if necessary to match the expected number
@@ -339,6 +401,13 @@ bool CppGenerator::Generate(const FileDescriptor* file,
     file_generator.GenerateSource(&p);
   }
 
+  if (file_options.lazy_pack_profile != nullptr) {
+    auto output = absl::WrapUnique(generator_context->Open(
+        absl::StrCat(basename, ".lazy_pack_report.txt")));
+    io::Printer p(output.get());
+    p.PrintRaw(LazyPackReport(file, file_options));
+  }
+
   return true;
 }
 }  // namespace cpp
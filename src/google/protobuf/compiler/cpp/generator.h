@@ -91,6 +91,8 @@ class PROTOC_EXPORT CppGenerator : public CodeGenerator {
     return FEATURE_PROTO3_OPTIONAL;
   }
 
+  bool SupportsParallelGeneration() const override { return true; }
+
  private:
   bool opensource_runtime_ = PROTO2_IS_OSS;
   std::string runtime_include_base_;
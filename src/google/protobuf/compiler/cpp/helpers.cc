@@ -59,6 +59,7 @@
 #include "absl/strings/strip.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "google/protobuf/compiler/cpp/lazy_pack_profile.h"
 #include "google/protobuf/compiler/cpp/names.h"
 #include "google/protobuf/compiler/cpp/options.h"
 #include "google/protobuf/descriptor.pb.h"
@@ -212,7 +213,8 @@ bool IsLazyPack(const FieldDescriptor* field, const Options& options,
   bool only_messages_has_lazy_pack_attr = !res || (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE); 
   GOOGLE_CHECK(only_messages_has_lazy_pack_attr) << 
     "\nOnly message type fields can be marked as [lazy_pack=true]!";
-  return res;
+  if (res || options.lazy_pack_profile == nullptr) return res;
+  return ChooseLazyPack(field, options).lazy_pack;
 }
 
 bool IsLazy(const FieldDescriptor* field, const Options& options,
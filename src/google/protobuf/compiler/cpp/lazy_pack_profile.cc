@@ -0,0 +1,189 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "google/protobuf/compiler/cpp/lazy_pack_profile.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/compiler/cpp/helpers.h"
+#include "google/protobuf/compiler/cpp/options.h"
+#include "google/protobuf/descriptor.pb.h"
+
+namespace google {
+namespace protobuf {
+namespace compiler {
+namespace cpp {
+
+namespace {
+
+// Lazy fields skip IsInitialized(), so a type which has required fields at
+// any depth is left eager.
+bool HasRequiredFieldsRecursive(const Descriptor* descriptor,
+                                absl::flat_hash_set<const Descriptor*>* seen) {
+  if (!seen->insert(descriptor).second) return false;
+  if (descriptor->extension_range_count() > 0) return true;
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    const FieldDescriptor* field = descriptor->field(i);
+    if (field->is_required()) return true;
+    if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE &&
+        HasRequiredFieldsRecursive(field->message_type(), seen)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string DescribeUsage(const LazyPackProfile::FieldStats* stats) {
+  if (stats == nullptr) return "no profile data";
+  if (stats->parses == 0) return "never parsed";
+  return absl::StrFormat("read after %.1f%% of %d parses",
+                         100.0 * stats->accesses / stats->parses,
+                         stats->parses);
+}
+
+void AppendReport(const Descriptor* descriptor, const Options& options,
+                  std::string* report) {
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    const FieldDescriptor* field = descriptor->field(i);
+    if (field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) continue;
+    LazyPackChoice choice = ChooseLazyPack(field, options);
+    absl::StrAppend(report, field->full_name(), ": ",
+                    choice.lazy_pack ? "lazy" : "eager", " (", choice.reason,
+                    ")\n");
+  }
+  for (int i = 0; i < descriptor->nested_type_count(); i++) {
+    if (IsMapEntryMessage(descriptor->nested_type(i))) continue;
+    AppendReport(descriptor->nested_type(i), options, report);
+  }
+}
+
+}  // namespace
+
+bool LazyPackProfile::Parse(absl::string_view text, std::string* error) {
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(text, '\n')) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::vector<absl::string_view> columns =
+        absl::StrSplit(line, absl::ByAnyChar(" \t\r"), absl::SkipEmpty());
+    if (columns.empty()) continue;
+
+    FieldStats stats;
+    if (columns.size() != 3 || !absl::SimpleAtoi(columns[1], &stats.parses) ||
+        !absl::SimpleAtoi(columns[2], &stats.accesses) || stats.parses < 0 ||
+        stats.accesses < 0) {
+      *error = absl::StrCat("lazy_pack profile line ", line_number,
+                            ": expected \"<field> <parses> <accesses>\"");
+      return false;
+    }
+    // Profiles merged from several binaries may list a field more than once.
+    FieldStats& total = fields_[columns[0]];
+    total.parses += stats.parses;
+    total.accesses += stats.accesses;
+  }
+  return true;
+}
+
+bool LazyPackProfile::Load(const std::string& path, std::string* error) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    *error = absl::StrCat("Cannot read lazy_pack profile: ", path);
+    return false;
+  }
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return Parse(contents.str(), error);
+}
+
+const LazyPackProfile::FieldStats* LazyPackProfile::Find(
+    const FieldDescriptor* field) const {
+  auto it = fields_.find(field->full_name());
+  return it == fields_.end() ? nullptr : &it->second;
+}
+
+LazyPackChoice ChooseLazyPack(const FieldDescriptor* field,
+                              const Options& options) {
+  const LazyPackProfile* profile = options.lazy_pack_profile;
+  const LazyPackProfile::FieldStats* stats =
+      profile != nullptr ? profile->Find(field) : nullptr;
+
+  if (field->options().lazy_pack()) {
+    return {true, absl::StrCat("marked [lazy_pack = true]; ",
+                               DescribeUsage(stats))};
+  }
+  if (field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+    return {false, "not a message"};
+  }
+  if (profile == nullptr) return {false, "no profile"};
+  if (field->is_map()) return {false, "map field"};
+  if (field->real_containing_oneof() != nullptr) return {false, "in a oneof"};
+  if (field->is_extension()) return {false, "extension"};
+  if (IsWeak(field, options)) return {false, "weak field"};
+  if (GetOptimizeFor(field->file(), options) == FileOptions::LITE_RUNTIME) {
+    return {false, "lite runtime"};
+  }
+  absl::flat_hash_set<const Descriptor*> seen;
+  if (HasRequiredFieldsRecursive(field->message_type(), &seen)) {
+    return {false, "type may have required fields"};
+  }
+  if (stats == nullptr) return {false, DescribeUsage(stats)};
+  if (stats->parses < options.lazy_pack_min_parses) {
+    return {false, absl::StrCat(DescribeUsage(stats), ", too few to decide")};
+  }
+  bool rarely_read = stats->accesses <=
+                     options.lazy_pack_max_access_ratio * stats->parses;
+  return {rarely_read, DescribeUsage(stats)};
+}
+
+std::string LazyPackReport(const FileDescriptor* file, const Options& options) {
+  std::string report =
+      absl::StrFormat("# lazy_pack choices for %s (at most %.1f%% read, at "
+                      "least %d parses)\n",
+                      file->name(), 100.0 * options.lazy_pack_max_access_ratio,
+                      options.lazy_pack_min_parses);
+  for (int i = 0; i < file->message_type_count(); i++) {
+    AppendReport(file->message_type(i), options, &report);
+  }
+  return report;
+}
+
+}  // namespace cpp
+}  // namespace compiler
+}  // namespace protobuf
+}  // namespace google
@@ -0,0 +1,103 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef GOOGLE_PROTOBUF_COMPILER_CPP_LAZY_PACK_PROFILE_H__
+#define GOOGLE_PROTOBUF_COMPILER_CPP_LAZY_PACK_PROFILE_H__
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/descriptor.h"
+
+namespace google {
+namespace protobuf {
+namespace compiler {
+namespace cpp {
+
+struct Options;
+
+// Per-field access counts, collected from a running binary, from which the
+// generator picks the message fields to generate as [lazy_pack = true].
+//
+// The profile is a text file with one field per line:
+//
+//   # field                            parses  accesses
+//   protobuf_unittest.BigProto.Folder  100000  1200
+//
+// "parses" counts the parsed messages in which the field was present and
+// "accesses" how many of those read it afterwards.  Blank lines and text
+// after '#' are ignored.
+class LazyPackProfile {
+ public:
+  struct FieldStats {
+    int64_t parses = 0;
+    int64_t accesses = 0;
+  };
+
+  // Returns false and sets *error if the text is malformed.
+  bool Parse(absl::string_view text, std::string* error);
+  bool Load(const std::string& path, std::string* error);
+
+  // Returns nullptr if the profile has no entry for the field.
+  const FieldStats* Find(const FieldDescriptor* field) const;
+
+ private:
+  absl::flat_hash_map<std::string, FieldStats> fields_;
+};
+
+// Whether a message field is generated lazily, and why.
+struct LazyPackChoice {
+  bool lazy_pack = false;
+  std::string reason;
+};
+
+// Decides whether `field` is generated as [lazy_pack = true].  Fields marked
+// so in the .proto file always are.  With a profile in `options`, a singular
+// or repeated message field also is if it was parsed at least
+// options.lazy_pack_min_parses times and read after at most
+// options.lazy_pack_max_access_ratio of those parses.  Map, oneof, extension
+// and weak fields are never chosen, nor are fields whose type has required
+// fields (lazy fields are not checked by IsInitialized()), nor fields of lite
+// runtime files.
+LazyPackChoice ChooseLazyPack(const FieldDescriptor* field,
+                              const Options& options);
+
+// Returns one line per message field of `file`, with the choice made for it
+// and the profile data behind it.
+std::string LazyPackReport(const FileDescriptor* file, const Options& options);
+
+}  // namespace cpp
+}  // namespace compiler
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // GOOGLE_PROTOBUF_COMPILER_CPP_LAZY_PACK_PROFILE_H__
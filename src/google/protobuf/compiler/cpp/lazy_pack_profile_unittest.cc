@@ -0,0 +1,164 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+// https://developers.google.com/protocol-buffers/
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "google/protobuf/compiler/cpp/lazy_pack_profile.h"
+
+#include <string>
+
+#include "google/protobuf/testing/file.h"
+#include "google/protobuf/compiler/command_line_interface.h"
+#include "google/protobuf/compiler/cpp/generator.h"
+#include "google/protobuf/testing/googletest.h"
+#include <gtest/gtest.h>
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+
+namespace google {
+namespace protobuf {
+namespace compiler {
+namespace cpp {
+namespace {
+
+TEST(LazyPackProfileTest, Parse) {
+  LazyPackProfile profile;
+  std::string error;
+  ASSERT_TRUE(profile.Parse(
+      "# field  parses  accesses\n"
+      "\n"
+      "foo.Bar.baz  100  3\n"
+      "foo.Bar.baz\t50\t2  # from a second binary\n",
+      &error))
+      << error;
+
+  EXPECT_FALSE(profile.Parse("foo.Bar.qux 100\n", &error));
+  EXPECT_EQ(error,
+            "lazy_pack profile line 1: expected "
+            "\"<field> <parses> <accesses>\"");
+  EXPECT_FALSE(profile.Parse("\nfoo.Bar.qux 100 many\n", &error));
+  EXPECT_TRUE(absl::StrContains(error, "line 2"));
+}
+
+class LazyPackGeneratorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    GOOGLE_CHECK_OK(File::SetContents(TestTempDir() + "/lazy.proto",
+                               "syntax = \"proto2\";\n"
+                               "package foo;\n"
+                               "message Baz { optional string name = 1; }\n"
+                               "message Req { required int32 id = 1; }\n"
+                               "message Bar {\n"
+                               "  optional Baz cold = 1;\n"
+                               "  optional Baz hot = 2;\n"
+                               "  repeated Baz cold_list = 3;\n"
+                               "  optional Baz rare = 4;\n"
+                               "  optional Baz unknown = 5;\n"
+                               "  optional Req required = 6;\n"
+                               "  oneof choice { Baz cold_oneof = 7; }\n"
+                               "  map<int32, Baz> cold_map = 8;\n"
+                               "  optional Baz marked = 9 [lazy_pack = true];\n"
+                               "}\n",
+                               true));
+    GOOGLE_CHECK_OK(File::SetContents(TestTempDir() + "/lazy_profile.txt",
+                               "foo.Bar.cold        1000    10\n"
+                               "foo.Bar.hot         1000   900\n"
+                               "foo.Bar.cold_list   1000     0\n"
+                               "foo.Bar.rare          20     0\n"
+                               "foo.Bar.required    1000     0\n"
+                               "foo.Bar.cold_oneof  1000     0\n"
+                               "foo.Bar.cold_map    1000     0\n"
+                               "foo.Bar.marked      1000  1000\n",
+                               true));
+  }
+
+  int RunProtoc(const std::string& parameters) {
+    CommandLineInterface cli;
+    cli.SetInputsAreProtoPathRelative(true);
+    CppGenerator cpp_generator;
+    cli.RegisterGenerator("--cpp_out", &cpp_generator, "");
+
+    std::string proto_path = "-I" + TestTempDir();
+    std::string cpp_out =
+        absl::StrCat("--cpp_out=", parameters, ":", TestTempDir());
+    const char* argv[] = {"protoc", proto_path.c_str(), cpp_out.c_str(),
+                          "lazy.proto"};
+    return cli.Run(4, argv);
+  }
+};
+
+TEST_F(LazyPackGeneratorTest, ChoosesRarelyReadFields) {
+  ASSERT_EQ(0, RunProtoc(absl::StrCat("lazy_pack_profile=", TestTempDir(),
+                                      "/lazy_profile.txt,"
+                                      "lazy_pack_min_parses=100")));
+
+  std::string report;
+  GOOGLE_CHECK_OK(File::GetContents(
+      TestTempDir() + "/lazy.lazy_pack_report.txt", &report, true));
+  EXPECT_TRUE(absl::StrContains(
+      report, "foo.Bar.cold: lazy (read after 1.0% of 1000 parses)\n"));
+  EXPECT_TRUE(absl::StrContains(
+      report, "foo.Bar.hot: eager (read after 90.0% of 1000 parses)\n"));
+  EXPECT_TRUE(absl::StrContains(
+      report, "foo.Bar.cold_list: lazy (read after 0.0% of 1000 parses)\n"));
+  EXPECT_TRUE(absl::StrContains(
+      report,
+      "foo.Bar.rare: eager (read after 0.0% of 20 parses, too few to "
+      "decide)\n"));
+  EXPECT_TRUE(
+      absl::StrContains(report, "foo.Bar.unknown: eager (no profile data)\n"));
+  EXPECT_TRUE(absl::StrContains(
+      report, "foo.Bar.required: eager (type may have required fields)\n"));
+  EXPECT_TRUE(
+      absl::StrContains(report, "foo.Bar.cold_oneof: eager (in a oneof)\n"));
+  EXPECT_TRUE(
+      absl::StrContains(report, "foo.Bar.cold_map: eager (map field)\n"));
+  EXPECT_TRUE(absl::StrContains(
+      report,
+      "foo.Bar.marked: lazy (marked [lazy_pack = true]; read after 100.0% of "
+      "1000 parses)\n"));
+
+  std::string header;
+  GOOGLE_CHECK_OK(
+      File::GetContents(TestTempDir() + "/lazy.pb.h", &header, true));
+  EXPECT_TRUE(absl::StrContains(header, "TLazyField<::foo::Baz>* cold_;"));
+  EXPECT_TRUE(absl::StrContains(
+      header, "RepeatedLazyField<::foo::Baz> cold_list_;"));
+  EXPECT_FALSE(absl::StrContains(header, "TLazyField<::foo::Baz>* hot_;"));
+}
+
+TEST_F(LazyPackGeneratorTest, RejectsBadOptions) {
+  EXPECT_NE(0, RunProtoc("lazy_pack_profile=" + TestTempDir() + "/missing"));
+  EXPECT_NE(0, RunProtoc("lazy_pack_max_access_ratio=often"));
+}
+
+}  // namespace
+}  // namespace cpp
+}  // namespace compiler
+}  // namespace protobuf
+}  // namespace google
@@ -741,9 +741,21 @@ RepeatedMessageFieldGenerator::RepeatedMessageFieldGenerator(
     : FieldGenerator(descriptor, options),
       implicit_weak_field_(
           IsImplicitWeakField(descriptor, options, scc_analyzer)),
+      lazy_pack_field_(IsLazyPack(descriptor, options, scc_analyzer)),
       has_required_fields_(
           scc_analyzer->HasRequiredFields(descriptor->message_type())) {
   SetMessageVariables(descriptor, options, implicit_weak_field_, &variables_);
+  // Lazily packed elements are kept as offsets into shared buffers rather
+  // than as one TLazyField object each.
+  if (lazy_pack_field_) {
+    variables_["repeated_type"] =
+        absl::StrCat("::", ProtobufNamespace(options), "::RepeatedLazyField<",
+                     FieldMessageTypeName(descriptor, options), ">");
+  } else {
+    variables_["repeated_type"] =
+        absl::StrCat("::", ProtobufNamespace(options), "::RepeatedPtrField< ",
+                     variables_["type"], " >");
+  }
 }
 
 RepeatedMessageFieldGenerator::~RepeatedMessageFieldGenerator() {}
@@ -754,7 +766,7 @@ void RepeatedMessageFieldGenerator::GeneratePrivateMembers(
   if (implicit_weak_field_) {
     format("::$proto_ns$::WeakRepeatedPtrField< $type$ > $name$_;\n");
   } else {
-    format("::$proto_ns$::RepeatedPtrField< $type$ > $name$_;\n");
+    format("$repeated_type$ $name$_;\n");
   }
 }
 
@@ -765,20 +777,20 @@ void RepeatedMessageFieldGenerator::GenerateAccessorDeclarations(
     format(
         "$deprecated_attr$$type$* ${1$mutable_$name$$}$(int index) { "
         "__builtin_trap(); }\n"
-        "$deprecated_attr$::$proto_ns$::RepeatedPtrField< $type$ >*\n"
+        "$deprecated_attr$$repeated_type$*\n"
         "    ${1$mutable_$name$$}$() { __builtin_trap(); }\n"
         "$deprecated_attr$const $type$& ${1$$name$$}$(int index) const { "
         "__builtin_trap(); }\n"
         "$deprecated_attr$$type$* ${1$add_$name$$}$() { "
         "__builtin_trap(); }\n"
-        "$deprecated_attr$const ::$proto_ns$::RepeatedPtrField< $type$ >&\n"
+        "$deprecated_attr$const $repeated_type$&\n"
         "    ${1$$name$$}$() const { __builtin_trap(); }\n",
         descriptor_);
     return;
   }
   format(
       "$deprecated_attr$$type$* ${1$mutable_$name$$}$(int index);\n"
-      "$deprecated_attr$::$proto_ns$::RepeatedPtrField< $type$ >*\n"
+      "$deprecated_attr$$repeated_type$*\n"
       "    ${1$mutable_$name$$}$();\n",
       descriptor_);
   if (!IsFieldStripped(descriptor_, options_)) {
@@ -792,7 +804,7 @@ void RepeatedMessageFieldGenerator::GenerateAccessorDeclarations(
   format(
       "$deprecated_attr$const $type$& ${1$$name$$}$(int index) const;\n"
       "$deprecated_attr$$type$* ${1$add_$name$$}$();\n"
-      "$deprecated_attr$const ::$proto_ns$::RepeatedPtrField< $type$ >&\n"
+      "$deprecated_attr$const $repeated_type$&\n"
       "    ${1$$name$$}$() const;\n",
       descriptor_);
 }
@@ -810,7 +822,7 @@ void RepeatedMessageFieldGenerator::GenerateInlineAccessorDefinitions(
       "$type_reference_function$"
       "  return $field$$weak$.Mutable(index);\n"
       "}\n"
-      "inline ::$proto_ns$::RepeatedPtrField< $type$ >*\n"
+      "inline $repeated_type$*\n"
       "$classname$::mutable_$name$() {\n"
       "$annotate_mutable_list$"
       "  // @@protoc_insertion_point(field_mutable_list:$full_name$)\n"
@@ -851,7 +863,7 @@ void RepeatedMessageFieldGenerator::GenerateInlineAccessorDefinitions(
       "}\n");
 
   format(
-      "inline const ::$proto_ns$::RepeatedPtrField< $type$ >&\n"
+      "inline const $repeated_type$&\n"
       "$classname$::$name$() const {\n"
       "$annotate_list$"
       "  // @@protoc_insertion_point(field_list:$full_name$)\n"
@@ -896,6 +908,8 @@ void RepeatedMessageFieldGenerator::GenerateDestructorCode(
   Formatter format(printer, variables_);
   if (implicit_weak_field_) {
     format("$field$.~WeakRepeatedPtrField();\n");
+  } else if (lazy_pack_field_) {
+    format("$field$.~RepeatedLazyField();\n");
   } else {
     format("$field$.~RepeatedPtrField();\n");
   }
@@ -906,7 +920,12 @@ void RepeatedMessageFieldGenerator::GenerateSerializeWithCachedSizesToArray(
   GOOGLE_CHECK(!IsFieldStripped(descriptor_, options_));
 
   Formatter format(printer, variables_);
-  if (implicit_weak_field_) {
+  if (lazy_pack_field_) {
+    // Elements that were never accessed are written out verbatim.
+    format(
+        "target = this->$field$.InternalSerialize($number$, target, "
+        "stream);\n");
+  } else if (implicit_weak_field_) {
     format(
         "for (auto it = this->$field$.pointer_begin(),\n"
         "          end = this->$field$.pointer_end(); it < end; ++it) {\n");
@@ -952,6 +971,12 @@ void RepeatedMessageFieldGenerator::GenerateByteSize(
   GOOGLE_CHECK(!IsFieldStripped(descriptor_, options_));
 
   Formatter format(printer, variables_);
+  if (lazy_pack_field_) {
+    format(
+        "total_size += $tag_size$UL * this->_internal_$name$_size();\n"
+        "total_size += this->$field$.ElementsByteSizeLong();\n");
+    return;
+  }
   format(
       "total_size += $tag_size$UL * this->_internal_$name$_size();\n"
       "for (const auto& msg : this->$field$) {\n"
@@ -964,7 +989,8 @@ void RepeatedMessageFieldGenerator::GenerateIsInitialized(
     io::Printer* printer) const {
   GOOGLE_CHECK(!IsFieldStripped(descriptor_, options_));
 
-  if (!has_required_fields_) return;
+  // Lazily packed elements are not checked until they are unpacked.
+  if (!has_required_fields_ || lazy_pack_field_) return;
 
   Formatter format(printer, variables_);
   if (implicit_weak_field_) {
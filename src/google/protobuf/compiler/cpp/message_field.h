@@ -137,6 +137,7 @@ class RepeatedMessageFieldGenerator : public FieldGenerator {
 
  private:
   const bool implicit_weak_field_;
+  const bool lazy_pack_field_;
   const bool has_required_fields_;
 };
 
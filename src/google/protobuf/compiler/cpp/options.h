@@ -33,6 +33,7 @@
 #ifndef GOOGLE_PROTOBUF_COMPILER_CPP_OPTIONS_H__
 #define GOOGLE_PROTOBUF_COMPILER_CPP_OPTIONS_H__
 
+#include <cstdint>
 #include <string>
 
 #include "absl/container/flat_hash_set.h"
@@ -44,6 +45,7 @@ class AccessInfoMap;
 class SplitMap;
 
 namespace cpp {
+class LazyPackProfile;
 
 enum class EnforceOptimizeMode {
   kNoEnforcement,  // Use the runtime specified by the file specific options.
@@ -61,6 +63,7 @@ struct FieldListenerOptions {
 struct Options {
   const AccessInfoMap* access_info_map = nullptr;
   const SplitMap* split_map = nullptr;
+  const LazyPackProfile* lazy_pack_profile = nullptr;
   std::string dllexport_decl;
   std::string runtime_include_base;
   std::string annotation_pragma_name;
@@ -87,6 +90,8 @@ struct Options {
   bool message_owned_arena_trial = false;
   bool force_split = false;
   bool profile_driven_split = true;
+  double lazy_pack_max_access_ratio = 0.05;
+  int64_t lazy_pack_min_parses = 1000;
 #ifdef PROTOBUF_STABLE_EXPERIMENTS
   bool force_eagerly_verified_lazy = true;
   bool force_inline_string = true;
@@ -1104,13 +1104,13 @@ void ParseFunctionGenerator::GenerateLengthDelim(Formatter& format,
               QualifiedDefaultInstanceName(field->message_type(), options_),
               field->number());
         } else if (IsLazyPack(field, options_, scc_analyzer_)) {
-          format (
-            "if (ctx->IsDerivedFromReleasableBufferStream()) {\n"
-            "  $msg$_internal_$mutable_field$()->_InternalParse(ctx->GetBinaryMessageAsBuffersArray(&ptr));\n"
-            "} else {\n"
-            "  $msg$_internal_$mutable_field$()->_InternalParse(ctx->GetBinaryMessage(&ptr));\n"
-            "}\n"
-          );
+          if (field->is_repeated()) {
+            format("ptr = $msg$$field$.InternalParseElement(ptr, ctx);\n");
+          } else {
+            format(
+                "ptr = $msg$_internal_$mutable_field$()->"
+                "_InternalParseLengthDelimited(ptr, ctx);\n");
+          }
         } else {
           format(
               "ptr = ctx->ParseMessage($msg$_internal_$mutable_field$(), "
@@ -114,6 +114,7 @@ class MockCodeGenerator : public CodeGenerator {
 
   uint64_t GetSupportedFeatures() const override;
   void SuppressFeatures(uint64_t features);
+  bool SupportsParallelGeneration() const override { return true; }
 
  private:
   std::string name_;
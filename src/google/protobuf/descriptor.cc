@@ -36,6 +36,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdlib>
 #include <functional>
 #include <limits>
@@ -1202,6 +1203,99 @@ class FlatAllocator
 // ===================================================================
 // DescriptorPool::Tables
 
+namespace {
+
+inline absl::string_view CommittedIndexKey(Symbol symbol) {
+  return symbol.full_name();
+}
+inline absl::string_view CommittedIndexKey(const FileDescriptor* file) {
+  return file->name();
+}
+inline bool IsEmptyIndexEntry(Symbol symbol) { return symbol.IsNull(); }
+inline bool IsEmptyIndexEntry(const FileDescriptor* file) {
+  return file == nullptr;
+}
+
+// An insert-only hash set of committed symbols or files, keyed by name, which
+// can be probed without holding the pool's mutex.
+//
+// Insert() must be serialized by the caller (it is only called with the pool's
+// mutex held); Find() may run concurrently with it.  Entries are published with
+// release stores, so a reader that finds an entry also sees the descriptor it
+// points to.  When the table gets half full it is copied into one twice the
+// size and the new one is published.  Superseded tables may still be probed by
+// readers, so they are only freed together with the index; since the sizes
+// are geometric they never add up to more than the live table.
+template <typename T>
+class CommittedNameIndex {
+ public:
+  CommittedNameIndex() = default;
+  CommittedNameIndex(const CommittedNameIndex&) = delete;
+  CommittedNameIndex& operator=(const CommittedNameIndex&) = delete;
+
+  // Returns an empty entry if `name` has not been inserted.
+  T Find(absl::string_view name) const {
+    const Table* table = table_.load(std::memory_order_acquire);
+    if (table == nullptr) return T();
+    for (size_t i = Hash(name) & table->mask;; i = (i + 1) & table->mask) {
+      T entry = table->slots[i].load(std::memory_order_acquire);
+      if (IsEmptyIndexEntry(entry) || CommittedIndexKey(entry) == name) {
+        return entry;
+      }
+    }
+  }
+
+  // `entry` must not already be in the index.
+  void Insert(T entry) {
+    const Table* table = table_.load(std::memory_order_relaxed);
+    if (table == nullptr || 2 * (size_ + 1) > table->mask + 1) {
+      table = Grow(table);
+    }
+    InsertInto(*table, entry);
+    ++size_;
+  }
+
+ private:
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1), slots(new std::atomic<T>[capacity]()) {}
+    size_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  static size_t Hash(absl::string_view name) {
+    return absl::Hash<absl::string_view>()(name);
+  }
+
+  static void InsertInto(const Table& table, T entry) {
+    size_t i = Hash(CommittedIndexKey(entry)) & table.mask;
+    while (!IsEmptyIndexEntry(table.slots[i].load(std::memory_order_relaxed))) {
+      i = (i + 1) & table.mask;
+    }
+    table.slots[i].store(entry, std::memory_order_release);
+  }
+
+  const Table* Grow(const Table* old_table) {
+    size_t capacity = old_table == nullptr ? 64 : 2 * (old_table->mask + 1);
+    tables_.emplace_back(new Table(capacity));
+    const Table* table = tables_.back().get();
+    if (old_table != nullptr) {
+      for (size_t i = 0; i <= old_table->mask; ++i) {
+        T entry = old_table->slots[i].load(std::memory_order_relaxed);
+        if (!IsEmptyIndexEntry(entry)) InsertInto(*table, entry);
+      }
+    }
+    table_.store(table, std::memory_order_release);
+    return table;
+  }
+
+  std::atomic<const Table*> table_{nullptr};
+  std::vector<std::unique_ptr<Table>> tables_;
+  size_t size_ = 0;
+};
+
+}  // namespace
+
 class DescriptorPool::Tables {
  public:
   Tables();
@@ -1287,6 +1381,15 @@ class DescriptorPool::Tables {
 
   // These return nullptr if not found.
   inline const FileDescriptor* FindFile(absl::string_view key) const;
+
+  // Pools that are shared between threads (those with a mutex) also keep an
+  // index of the committed symbols and files which is safe to probe without
+  // holding the mutex.  These return a null Symbol / nullptr if the name is
+  // not found or its file has not been committed yet, in which case the caller
+  // must fall back to the locked lookup.
+  void EnableCommittedIndex() { committed_index_enabled_ = true; }
+  inline Symbol FindCommittedSymbol(absl::string_view key) const;
+  inline const FileDescriptor* FindCommittedFile(absl::string_view key) const;
   inline const FieldDescriptor* FindExtension(const Descriptor* extendee,
                                               int number) const;
   inline void FindAllExtensions(const Descriptor* extendee,
@@ -1348,6 +1451,12 @@ class DescriptorPool::Tables {
   FilesByNameSet files_by_name_;
   ExtensionsGroupedByDescriptorMap extensions_;
 
+  // Committed subsets of symbols_by_name_ and files_by_name_, filled in by
+  // ClearLastCheckpoint() when committed_index_enabled_ is set.
+  bool committed_index_enabled_ = false;
+  CommittedNameIndex<Symbol> committed_symbols_;
+  CommittedNameIndex<const FileDescriptor*> committed_files_;
+
   struct CheckPoint {
     explicit CheckPoint(const Tables* tables)
         : flat_allocations_before_checkpoint(
@@ -1418,6 +1527,14 @@ void DescriptorPool::Tables::ClearLastCheckpoint() {
   if (checkpoints_.empty()) {
     // All checkpoints have been cleared: we can now commit all of the pending
     // data.
+    if (committed_index_enabled_) {
+      for (Symbol symbol : symbols_after_checkpoint_) {
+        committed_symbols_.Insert(symbol);
+      }
+      for (const FileDescriptor* file : files_after_checkpoint_) {
+        committed_files_.Insert(file);
+      }
+    }
     symbols_after_checkpoint_.clear();
     files_after_checkpoint_.clear();
     extensions_after_checkpoint_.clear();
@@ -1465,15 +1582,24 @@ inline Symbol FileDescriptorTables::FindNestedSymbol(
   return it == symbols_by_parent_.end() ? Symbol() : *it;
 }
 
+inline Symbol DescriptorPool::Tables::FindCommittedSymbol(
+    absl::string_view key) const {
+  return committed_symbols_.Find(key);
+}
+
+inline const FileDescriptor* DescriptorPool::Tables::FindCommittedFile(
+    absl::string_view key) const {
+  return committed_files_.Find(key);
+}
+
 Symbol DescriptorPool::Tables::FindByNameHelper(const DescriptorPool* pool,
                                                 absl::string_view name) {
   if (pool->mutex_ != nullptr) {
-    // Fast path: the Symbol is already cached.  This is just a hash lookup.
-    absl::ReaderMutexLock lock(pool->mutex_);
-    if (known_bad_symbols_.empty() && known_bad_files_.empty()) {
-      Symbol result = FindSymbol(name);
-      if (!result.IsNull()) return result;
-    }
+    // Fast path: the Symbol is already cached.  This is just a lock-free hash
+    // lookup; only misses, which may have to consult the fallback database,
+    // take the mutex.
+    Symbol result = FindCommittedSymbol(name);
+    if (!result.IsNull()) return result;
   }
   absl::MutexLockMaybe lock(pool->mutex_);
   if (pool->fallback_database_ != nullptr) {
@@ -1826,7 +1952,9 @@ DescriptorPool::DescriptorPool(DescriptorDatabase* fallback_database,
       lazily_build_dependencies_(false),
       allow_unknown_(false),
       enforce_weak_(false),
-      disallow_enforce_utf8_(false) {}
+      disallow_enforce_utf8_(false) {
+  tables_->EnableCommittedIndex();
+}
 
 DescriptorPool::DescriptorPool(const DescriptorPool* underlay)
     : mutex_(nullptr),
@@ -1938,6 +2066,10 @@ void DescriptorPool::InternalAddGeneratedFile(
 
 const FileDescriptor* DescriptorPool::FindFileByName(
     absl::string_view name) const {
+  if (mutex_ != nullptr) {
+    const FileDescriptor* result = tables_->FindCommittedFile(name);
+    if (result != nullptr) return result;
+  }
   absl::MutexLockMaybe lock(mutex_);
   if (fallback_database_ != nullptr) {
     tables_->known_bad_symbols_.clear();
@@ -1797,6 +1797,8 @@ class PROTOBUF_EXPORT DescriptorPool {
   //   them slower even when they don't have to fall back to the database.
   //   In fact, even the Find*By*() methods of descriptor objects owned by
   //   this pool will be slower, since they will have to obtain locks too.
+  //   FindFileByName() and the Find*ByName() methods are the exception: names
+  //   of files that have already been loaded are found without locking.
   // - An ErrorCollector may optionally be given to collect validation errors
   //   in files loaded from the database.  If not given, errors will be printed
   //   to GOOGLE_LOG(ERROR).  Remember that files are built on-demand, so this
@@ -2102,7 +2104,8 @@ class PROTOBUF_EXPORT DescriptorPool {
                                      PlaceholderType placeholder_type) const;
 
   // If fallback_database_ is nullptr, this is nullptr.  Otherwise, this is a
-  // mutex which must be locked while accessing tables_.
+  // mutex which must be locked while accessing tables_, except for its index
+  // of committed symbols and files.
   absl::Mutex* mutex_;
 
   // See constructor.
@@ -34,15 +34,47 @@
 
 #include "google/protobuf/descriptor_database.h"
 
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <set>
+#include <tuple>
 #include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_replace.h"
 #include "google/protobuf/descriptor.pb.h"
-
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/io_win32.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/wire_format_lite.h"
+
+
+#ifdef _WIN32
+// DO NOT include <io.h>, instead create functions in io_win32.{h,cc} and import
+// them like we do below.
+using google::protobuf::io::win32::close;
+using google::protobuf::io::win32::open;
+#endif
+
+#ifndef O_BINARY
+#ifdef _O_BINARY
+#define O_BINARY _O_BINARY
+#else
+#define O_BINARY 0  // If this isn't defined, the platform doesn't need it.
+#endif
+#endif
 
 namespace google {
 namespace protobuf {
@@ -581,19 +613,506 @@ bool EncodedDescriptorDatabase::AddCopy(const void* encoded_file_descriptor,
   return Add(copy, size);
 }
 
+bool EncodedDescriptorDatabase::AddFileDescriptorSet(
+    io::RefCountBuffer encoded_file_descriptor_set) {
+  using internal::WireFormatLite;
+  const uint8_t* data = encoded_file_descriptor_set.data.get();
+  io::CodedInputStream input(data, encoded_file_descriptor_set.size);
+  shared_buffers_.push_back(std::move(encoded_file_descriptor_set));
+
+  const uint32_t file_tag =
+      WireFormatLite::MakeTag(FileDescriptorSet::kFileFieldNumber,
+                              WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  while (uint32_t tag = input.ReadTag()) {
+    if (tag != file_tag) {
+      if (!WireFormatLite::SkipField(&input, tag)) break;
+      continue;
+    }
+    uint32_t size;
+    if (!input.ReadVarint32(&size)) break;
+    const int offset = input.CurrentPosition();
+    if (!input.Skip(static_cast<int>(size))) break;
+    if (!Add(data + offset, static_cast<int>(size))) return false;
+  }
+  if (!input.ConsumedEntireMessage()) {
+    GOOGLE_LOG(ERROR) << "Invalid FileDescriptorSet passed to "
+                  "EncodedDescriptorDatabase::AddFileDescriptorSet().";
+    return false;
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------
+// Snapshot index
+//
+// WriteSnapshot() puts an index of the snapshot's files in front of them, as
+// an unknown field of the FileDescriptorSet.  AddSnapshot() looks names up in
+// the mapped index directly instead of parsing every file into a
+// DescriptorIndex.
+//
+// The index is a sequence of little-endian 32-bit words followed by the names
+// they refer to:
+//
+//   version, file_count, symbol_count, extension_count
+//   file_count      x {data_offset, data_size, name_offset, name_size}
+//   symbol_count    x {name_offset, name_size, file}
+//   extension_count x {extendee_offset, extendee_size, number, file}
+//   names
+//
+// Files are sorted by name, symbols (fully-qualified, as in DescriptorIndex)
+// by name, and extensions by extendee (without the leading '.') and number.
+// `file` indexes the file table, data offsets are relative to the end of the
+// index field, and name offsets to the start of the names.  Offsets are
+// checked when they are read, so a corrupt index fails lookups instead of
+// reading out of bounds.
+
+namespace {
+
+// Not a field of FileDescriptorSet, so parsers skip the index.
+constexpr int kSnapshotIndexFieldNumber = 536870911;
+constexpr uint32_t kSnapshotIndexVersion = 1;
+constexpr int kSnapshotHeaderWords = 4;
+constexpr int kSnapshotFileWords = 4;
+constexpr int kSnapshotSymbolWords = 3;
+constexpr int kSnapshotExtensionWords = 4;
+
+class SnapshotIndexWriter {
+ public:
+  // Adds a file whose encoding is `data_size` bytes at `data_offset`.
+  void AddFile(const FileDescriptorProto& file, uint32_t data_offset,
+               uint32_t data_size) {
+    const int index = static_cast<int>(files_.size());
+    files_.push_back({file.name(), data_offset, data_size});
+    const std::string prefix =
+        file.package().empty() ? "" : absl::StrCat(file.package(), ".");
+    for (const auto& message_type : file.message_type()) {
+      symbols_.push_back({prefix + message_type.name(), index});
+      AddNestedExtensions(message_type, index);
+    }
+    for (const auto& enum_type : file.enum_type()) {
+      symbols_.push_back({prefix + enum_type.name(), index});
+    }
+    for (const auto& extension : file.extension()) {
+      symbols_.push_back({prefix + extension.name(), index});
+      AddExtension(extension, index);
+    }
+    for (const auto& service : file.service()) {
+      symbols_.push_back({prefix + service.name(), index});
+    }
+  }
+
+  // Returns the encoded index.
+  std::string Finish() {
+    // Sort the files and renumber the references to them.
+    std::vector<int> order(files_.size());
+    for (int i = 0; i < static_cast<int>(order.size()); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+      return files_[a].name < files_[b].name;
+    });
+    std::vector<uint32_t> position(files_.size());
+    for (int i = 0; i < static_cast<int>(order.size()); i++) {
+      position[order[i]] = i;
+    }
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](const SymbolEntry& a, const SymbolEntry& b) {
+                return a.name < b.name;
+              });
+    std::sort(extensions_.begin(), extensions_.end(),
+              [](const ExtensionEntry& a, const ExtensionEntry& b) {
+                return std::tie(a.extendee, a.number) <
+                       std::tie(b.extendee, b.number);
+              });
+
+    std::vector<uint32_t> words = {
+        kSnapshotIndexVersion, static_cast<uint32_t>(files_.size()),
+        static_cast<uint32_t>(symbols_.size()),
+        static_cast<uint32_t>(extensions_.size())};
+    std::string names;
+    auto add_name = [&](const std::string& name) {
+      words.push_back(static_cast<uint32_t>(names.size()));
+      words.push_back(static_cast<uint32_t>(name.size()));
+      names += name;
+    };
+    for (int i : order) {
+      words.push_back(files_[i].data_offset);
+      words.push_back(files_[i].data_size);
+      add_name(files_[i].name);
+    }
+    for (const SymbolEntry& symbol : symbols_) {
+      add_name(symbol.name);
+      words.push_back(position[symbol.file]);
+    }
+    for (const ExtensionEntry& extension : extensions_) {
+      add_name(extension.extendee);
+      words.push_back(static_cast<uint32_t>(extension.number));
+      words.push_back(position[extension.file]);
+    }
+
+    std::string index(words.size() * sizeof(uint32_t), '\0');
+    uint8_t* target = reinterpret_cast<uint8_t*>(&index[0]);
+    for (uint32_t word : words) {
+      target = io::CodedOutputStream::WriteLittleEndian32ToArray(word, target);
+    }
+    return index + names;
+  }
+
+ private:
+  void AddNestedExtensions(const DescriptorProto& message_type, int file) {
+    for (const auto& nested_type : message_type.nested_type()) {
+      AddNestedExtensions(nested_type, file);
+    }
+    for (const auto& extension : message_type.extension()) {
+      AddExtension(extension, file);
+    }
+  }
+
+  void AddExtension(const FieldDescriptorProto& field, int file) {
+    // Like DescriptorIndex, only index fully-qualified extendees.
+    if (!field.extendee().empty() && field.extendee()[0] == '.') {
+      extensions_.push_back({field.extendee().substr(1), field.number(), file});
+    }
+  }
+
+  struct FileEntry {
+    std::string name;
+    uint32_t data_offset;
+    uint32_t data_size;
+  };
+  struct SymbolEntry {
+    std::string name;
+    int file;
+  };
+  struct ExtensionEntry {
+    std::string extendee;
+    int number;
+    int file;
+  };
+  std::vector<FileEntry> files_;
+  std::vector<SymbolEntry> symbols_;
+  std::vector<ExtensionEntry> extensions_;
+};
+
+}  // namespace
+
+class EncodedDescriptorDatabase::SnapshotIndex {
+ public:
+  using Value = std::pair<const void*, int>;
+
+  // Returns nullptr if the index is malformed.  `files` are the bytes
+  // following the index field, which data offsets are relative to.
+  static std::unique_ptr<SnapshotIndex> Open(const uint8_t* index,
+                                             uint32_t index_size,
+                                             const uint8_t* files,
+                                             uint32_t files_size) {
+    if (index_size < kSnapshotHeaderWords * sizeof(uint32_t)) return nullptr;
+    std::unique_ptr<SnapshotIndex> result(new SnapshotIndex);
+    if (ReadWord(index, 0) != kSnapshotIndexVersion) return nullptr;
+    result->file_count_ = ReadWord(index, 1);
+    result->symbol_count_ = ReadWord(index, 2);
+    result->extension_count_ = ReadWord(index, 3);
+    const uint64_t table_words =
+        uint64_t{kSnapshotHeaderWords} +
+        uint64_t{kSnapshotFileWords} * result->file_count_ +
+        uint64_t{kSnapshotSymbolWords} * result->symbol_count_ +
+        uint64_t{kSnapshotExtensionWords} * result->extension_count_;
+    if (table_words * sizeof(uint32_t) > index_size) return nullptr;
+    result->files_table_ = index + kSnapshotHeaderWords * sizeof(uint32_t);
+    result->symbols_table_ =
+        result->files_table_ +
+        kSnapshotFileWords * sizeof(uint32_t) * result->file_count_;
+    result->extensions_table_ =
+        result->symbols_table_ +
+        kSnapshotSymbolWords * sizeof(uint32_t) * result->symbol_count_;
+    result->names_ = index + table_words * sizeof(uint32_t);
+    result->names_size_ =
+        index_size - static_cast<uint32_t>(table_words * sizeof(uint32_t));
+    result->files_ = files;
+    result->files_size_ = files_size;
+    return result;
+  }
+
+  Value FindFile(absl::string_view filename) const {
+    const uint32_t i = LowerBound(file_count_, [&](uint32_t i) {
+      return FileName(i) < filename;
+    });
+    return i < file_count_ && FileName(i) == filename ? FileValue(i) : Value();
+  }
+
+  Value FindSymbol(absl::string_view name) const {
+    // The last symbol less than or equal to the name.
+    const uint32_t i = LowerBound(symbol_count_, [&](uint32_t i) {
+      return SymbolName(i) <= name;
+    });
+    if (i == 0 || !IsSubSymbol(SymbolName(i - 1), name)) return Value();
+    return FileValue(
+        ReadWord(symbols_table_, kSnapshotSymbolWords * (i - 1) + 2));
+  }
+
+  Value FindExtension(absl::string_view containing_type,
+                      int field_number) const {
+    const uint32_t i = FindFirstExtension(containing_type, field_number);
+    if (i == extension_count_ || Extendee(i) != containing_type ||
+        ExtensionNumber(i) != field_number) {
+      return Value();
+    }
+    return FileValue(ReadWord(extensions_table_,
+                              kSnapshotExtensionWords * i + 3));
+  }
+
+  bool FindAllExtensionNumbers(absl::string_view containing_type,
+                               std::vector<int>* output) const {
+    bool success = false;
+    for (uint32_t i = FindFirstExtension(containing_type, 0);
+         i < extension_count_ && Extendee(i) == containing_type; i++) {
+      output->push_back(ExtensionNumber(i));
+      success = true;
+    }
+    return success;
+  }
+
+  void FindAllFileNames(std::vector<std::string>* output) const {
+    for (uint32_t i = 0; i < file_count_; i++) {
+      output->push_back(std::string(FileName(i)));
+    }
+  }
+
+ private:
+  SnapshotIndex() = default;
+
+  static uint32_t ReadWord(const uint8_t* table, uint32_t i) {
+    uint32_t word;
+    io::CodedInputStream::ReadLittleEndian32FromArray(
+        table + i * sizeof(uint32_t), &word);
+    return word;
+  }
+
+  // Returns the first i in [0, count) for which less(i) is false, or count.
+  template <typename Less>
+  static uint32_t LowerBound(uint32_t count, Less less) {
+    uint32_t first = 0;
+    while (count > 0) {
+      const uint32_t half = count / 2;
+      if (less(first + half)) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first;
+  }
+
+  // Returns an empty name if the entry is out of bounds.
+  absl::string_view Name(const uint8_t* table, uint32_t word) const {
+    const uint32_t offset = ReadWord(table, word);
+    const uint32_t size = ReadWord(table, word + 1);
+    if (offset > names_size_ || size > names_size_ - offset) return {};
+    return absl::string_view(reinterpret_cast<const char*>(names_) + offset,
+                             size);
+  }
+  absl::string_view FileName(uint32_t i) const {
+    return Name(files_table_, kSnapshotFileWords * i + 2);
+  }
+  absl::string_view SymbolName(uint32_t i) const {
+    return Name(symbols_table_, kSnapshotSymbolWords * i);
+  }
+  absl::string_view Extendee(uint32_t i) const {
+    return Name(extensions_table_, kSnapshotExtensionWords * i);
+  }
+  int ExtensionNumber(uint32_t i) const {
+    return static_cast<int>(
+        ReadWord(extensions_table_, kSnapshotExtensionWords * i + 2));
+  }
+
+  uint32_t FindFirstExtension(absl::string_view containing_type,
+                              int field_number) const {
+    return LowerBound(extension_count_, [&](uint32_t i) {
+      return std::make_tuple(Extendee(i), ExtensionNumber(i)) <
+             std::make_tuple(containing_type, field_number);
+    });
+  }
+
+  // Returns an empty value if the file is out of bounds.
+  Value FileValue(uint32_t file) const {
+    if (file >= file_count_) return Value();
+    const uint32_t offset = ReadWord(files_table_, kSnapshotFileWords * file);
+    const uint32_t size =
+        ReadWord(files_table_, kSnapshotFileWords * file + 1);
+    if (offset > files_size_ || size > files_size_ - offset) return Value();
+    return {files_ + offset, static_cast<int>(size)};
+  }
+
+  uint32_t file_count_ = 0;
+  uint32_t symbol_count_ = 0;
+  uint32_t extension_count_ = 0;
+  const uint8_t* files_table_ = nullptr;
+  const uint8_t* symbols_table_ = nullptr;
+  const uint8_t* extensions_table_ = nullptr;
+  const uint8_t* names_ = nullptr;
+  uint32_t names_size_ = 0;
+  const uint8_t* files_ = nullptr;
+  uint32_t files_size_ = 0;
+};
+
+bool EncodedDescriptorDatabase::AddSnapshot(const std::string& filename) {
+  int file_descriptor;
+  do {
+    file_descriptor = open(filename.c_str(), O_RDONLY | O_BINARY);
+  } while (file_descriptor < 0 && errno == EINTR);
+  if (file_descriptor < 0) {
+    GOOGLE_LOG(ERROR) << "Could not open descriptor snapshot " << filename
+               << ": " << strerror(errno);
+    return false;
+  }
+  // The mapping outlives the file descriptor.
+  io::MmapInputStream input(file_descriptor);
+  close(file_descriptor);
+  if (input.GetErrno() != 0) {
+    GOOGLE_LOG(ERROR) << "Could not map descriptor snapshot " << filename
+               << ": " << strerror(input.GetErrno());
+    return false;
+  }
+
+  io::RefCountBuffer buffer;
+  const void* data;
+  int size;
+  if (input.Next(&data, &size)) {
+    buffer = input.GetSharedBuffer();
+    if (input.Next(&data, &size)) {
+      GOOGLE_LOG(ERROR) << "Descriptor snapshot " << filename
+                 << " is larger than 2GB.";
+      return false;
+    }
+  }
+
+  // Use the index if the snapshot starts with one.
+  using internal::WireFormatLite;
+  io::CodedInputStream index_input(buffer.data.get(), buffer.size);
+  uint32_t index_size;
+  if (index_input.ReadTag() ==
+          WireFormatLite::MakeTag(kSnapshotIndexFieldNumber,
+                                  WireFormatLite::WIRETYPE_LENGTH_DELIMITED) &&
+      index_input.ReadVarint32(&index_size)) {
+    const uint32_t index_offset = index_input.CurrentPosition();
+    const uint32_t files_offset = index_offset + index_size;
+    std::unique_ptr<SnapshotIndex> index;
+    if (index_size <= static_cast<uint32_t>(buffer.size) - index_offset) {
+      index = SnapshotIndex::Open(buffer.data.get() + index_offset, index_size,
+                                  buffer.data.get() + files_offset,
+                                  buffer.size - files_offset);
+    }
+    if (index == nullptr) {
+      GOOGLE_LOG(ERROR) << "Invalid index in descriptor snapshot " << filename
+                 << ".";
+      return false;
+    }
+    snapshot_indexes_.push_back(std::move(index));
+    shared_buffers_.push_back(std::move(buffer));
+    return true;
+  }
+  return AddFileDescriptorSet(std::move(buffer));
+}
+
+namespace {
+
+void AddWithDependencies(const FileDescriptor* file,
+                         absl::flat_hash_set<const FileDescriptor*>* seen,
+                         std::vector<const FileDescriptor*>* ordered) {
+  if (!seen->insert(file).second) return;
+  for (int i = 0; i < file->dependency_count(); i++) {
+    AddWithDependencies(file->dependency(i), seen, ordered);
+  }
+  ordered->push_back(file);
+}
+
+}  // namespace
+
+bool EncodedDescriptorDatabase::WriteSnapshot(
+    const std::vector<const FileDescriptor*>& files,
+    io::ZeroCopyOutputStream* output) {
+  using internal::WireFormatLite;
+  absl::flat_hash_set<const FileDescriptor*> seen;
+  std::vector<const FileDescriptor*> ordered;
+  for (const FileDescriptor* file : files) {
+    AddWithDependencies(file, &seen, &ordered);
+  }
+
+  // The index needs the offsets of the files, so encode them first.
+  SnapshotIndexWriter index_writer;
+  std::vector<std::string> encoded_files(ordered.size());
+  uint64_t files_size = 0;
+  FileDescriptorProto proto;
+  for (size_t i = 0; i < ordered.size(); i++) {
+    proto.Clear();
+    ordered[i]->CopyTo(&proto);
+    proto.SerializeToString(&encoded_files[i]);
+    const uint32_t size = static_cast<uint32_t>(encoded_files[i].size());
+    files_size += WireFormatLite::TagSize(FileDescriptorSet::kFileFieldNumber,
+                                          WireFormatLite::TYPE_MESSAGE) +
+                  io::CodedOutputStream::VarintSize32(size);
+    index_writer.AddFile(proto, static_cast<uint32_t>(files_size), size);
+    files_size += size;
+  }
+  if (files_size > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+    GOOGLE_LOG(ERROR) << "Descriptor snapshot would be larger than 2GB.";
+    return false;
+  }
+
+  io::CodedOutputStream coded_output(output);
+  WireFormatLite::WriteBytes(kSnapshotIndexFieldNumber, index_writer.Finish(),
+                             &coded_output);
+  for (const std::string& encoded_file : encoded_files) {
+    WireFormatLite::WriteBytes(FileDescriptorSet::kFileFieldNumber,
+                               encoded_file, &coded_output);
+  }
+  return !coded_output.HadError();
+}
+
+std::pair<const void*, int> EncodedDescriptorDatabase::FindEncodedFile(
+    absl::string_view filename) {
+  auto encoded_file = index_->FindFile(filename);
+  for (const auto& snapshot_index : snapshot_indexes_) {
+    if (encoded_file.first != nullptr) break;
+    encoded_file = snapshot_index->FindFile(filename);
+  }
+  return encoded_file;
+}
+
+std::pair<const void*, int>
+EncodedDescriptorDatabase::FindEncodedFileContainingSymbol(
+    absl::string_view symbol_name) {
+  auto encoded_file = index_->FindSymbol(symbol_name);
+  for (const auto& snapshot_index : snapshot_indexes_) {
+    if (encoded_file.first != nullptr) break;
+    encoded_file = snapshot_index->FindSymbol(symbol_name);
+  }
+  return encoded_file;
+}
+
+std::pair<const void*, int>
+EncodedDescriptorDatabase::FindEncodedFileContainingExtension(
+    absl::string_view containing_type, int field_number) {
+  auto encoded_file = index_->FindExtension(containing_type, field_number);
+  for (const auto& snapshot_index : snapshot_indexes_) {
+    if (encoded_file.first != nullptr) break;
+    encoded_file = snapshot_index->FindExtension(containing_type, field_number);
+  }
+  return encoded_file;
+}
+
 bool EncodedDescriptorDatabase::FindFileByName(const std::string& filename,
                                                FileDescriptorProto* output) {
-  return MaybeParse(index_->FindFile(filename), output);
+  return MaybeParse(FindEncodedFile(filename), output);
 }
 
 bool EncodedDescriptorDatabase::FindFileContainingSymbol(
     const std::string& symbol_name, FileDescriptorProto* output) {
-  return MaybeParse(index_->FindSymbol(symbol_name), output);
+  return MaybeParse(FindEncodedFileContainingSymbol(symbol_name), output);
 }
 
 bool EncodedDescriptorDatabase::FindNameOfFileContainingSymbol(
     const std::string& symbol_name, std::string* output) {
-  auto encoded_file = index_->FindSymbol(symbol_name);
+  auto encoded_file = FindEncodedFileContainingSymbol(symbol_name);
   if (encoded_file.first == nullptr) return false;
 
   // Optimization:  The name should be the first field in the encoded message.
@@ -622,13 +1141,18 @@ bool EncodedDescriptorDatabase::FindNameOfFileContainingSymbol(
 bool EncodedDescriptorDatabase::FindFileContainingExtension(
     const std::string& containing_type, int field_number,
     FileDescriptorProto* output) {
-  return MaybeParse(index_->FindExtension(containing_type, field_number),
-                    output);
+  return MaybeParse(
+      FindEncodedFileContainingExtension(containing_type, field_number),
+      output);
 }
 
 bool EncodedDescriptorDatabase::FindAllExtensionNumbers(
     const std::string& extendee_type, std::vector<int>* output) {
-  return index_->FindAllExtensionNumbers(extendee_type, output);
+  bool success = index_->FindAllExtensionNumbers(extendee_type, output);
+  for (const auto& snapshot_index : snapshot_indexes_) {
+    success |= snapshot_index->FindAllExtensionNumbers(extendee_type, output);
+  }
+  return success;
 }
 
 template <typename FileProto>
@@ -878,6 +1402,9 @@ EncodedDescriptorDatabase::DescriptorIndex::FindFile(
 bool EncodedDescriptorDatabase::FindAllFileNames(
     std::vector<std::string>* output) {
   index_->FindAllFileNames(output);
+  for (const auto& snapshot_index : snapshot_indexes_) {
+    snapshot_index->FindAllFileNames(output);
+  }
   return true;
 }
 
@@ -44,6 +44,7 @@
 #include <vector>
 
 #include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/port.h"
 
 // Must be included last.
@@ -306,6 +307,37 @@ class PROTOBUF_EXPORT EncodedDescriptorDatabase : public DescriptorDatabase {
   // need to keep it around.
   bool AddCopy(const void* encoded_file_descriptor, int size);
 
+  // Adds every file of an encoded FileDescriptorSet.  Like Add(), the files
+  // are not copied; instead the database holds a reference to the buffer for
+  // the rest of its life.  Returns false and logs an error if the bytes are
+  // not a valid FileDescriptorSet or if one of its files could not be added.
+  // The files preceding it remain in the database.
+  bool AddFileDescriptorSet(io::RefCountBuffer encoded_file_descriptor_set);
+
+  // Maps a snapshot written by WriteSnapshot() into memory and adds its files.
+  // Names are looked up directly in the index stored in the snapshot, which
+  // is neither parsed nor copied; files are only parsed when they are looked
+  // up, so a DescriptorPool backed by this database only builds the
+  // descriptors it is asked for.  The mapped pages are shared with every
+  // other process that maps the same snapshot.  Unlike Add(), the snapshot's
+  // files are not checked for conflicts with other files in the database.
+  //
+  // Any other encoded FileDescriptorSet (such as one written by protoc's
+  // --descriptor_set_out) is mapped and added as with AddFileDescriptorSet().
+  //
+  // Returns false and logs an error if the file cannot be mapped or is not a
+  // valid snapshot.
+  bool AddSnapshot(const std::string& filename);
+
+  // Writes `files` and all of their transitive dependencies to `output` as an
+  // encoded FileDescriptorSet, each file after the files it imports.  The set
+  // starts with an index of the files' names, symbols and extensions, stored
+  // as an unknown field so that the snapshot can still be read as a plain
+  // FileDescriptorSet.  This is the snapshot format read by AddSnapshot().
+  // Source code info is not written.
+  static bool WriteSnapshot(const std::vector<const FileDescriptor*>& files,
+                            io::ZeroCopyOutputStream* output);
+
   // Like FindFileContainingSymbol but returns only the name of the file.
   bool FindNameOfFileContainingSymbol(const std::string& symbol_name,
                                       std::string* output);
@@ -324,10 +356,23 @@ class PROTOBUF_EXPORT EncodedDescriptorDatabase : public DescriptorDatabase {
 
  private:
   class DescriptorIndex;
+  class SnapshotIndex;
   // Keep DescriptorIndex by pointer to hide the implementation to keep a
   // cleaner header.
   std::unique_ptr<DescriptorIndex> index_;
+  // Indexes of the snapshots added by AddSnapshot(), searched after index_.
+  std::vector<std::unique_ptr<SnapshotIndex>> snapshot_indexes_;
   std::vector<void*> files_to_delete_;
+  // Buffers added by AddFileDescriptorSet() and AddSnapshot(), which the
+  // indexes point into.
+  std::vector<io::RefCountBuffer> shared_buffers_;
+
+  // Look up the encoded file in index_ and then in snapshot_indexes_.
+  std::pair<const void*, int> FindEncodedFile(absl::string_view filename);
+  std::pair<const void*, int> FindEncodedFileContainingSymbol(
+      absl::string_view symbol_name);
+  std::pair<const void*, int> FindEncodedFileContainingExtension(
+      absl::string_view containing_type, int field_number);
 
   // If encoded_file.first is non-nullptr, parse the data into *output and
   // return true, otherwise return false.
@@ -43,8 +43,10 @@
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/text_format.h"
 #include <gmock/gmock.h>
+#include "google/protobuf/testing/file.h"
 #include "google/protobuf/testing/googletest.h"
 #include <gtest/gtest.h>
 
@@ -517,6 +519,166 @@ TEST(EncodedDescriptorDatabaseExtraTest, FindNameOfFileContainingSymbol) {
   EXPECT_FALSE(db.FindNameOfFileContainingSymbol("baz.Baz", &filename));
 }
 
+TEST(EncodedDescriptorDatabaseExtraTest, AddFileDescriptorSet) {
+  FileDescriptorSet set;
+  FileDescriptorProto* foo = set.add_file();
+  foo->set_name("foo.proto");
+  foo->set_package("foo");
+  foo->add_message_type()->set_name("Foo");
+  FileDescriptorProto* bar = set.add_file();
+  bar->set_name("bar.proto");
+  bar->add_message_type()->set_name("Bar");
+
+  std::string data = set.SerializeAsString();
+  io::RefCountBuffer buffer;
+  buffer.data.reset(new uint8_t[data.size()]);
+  buffer.size = static_cast<int>(data.size());
+  memcpy(buffer.data.get(), data.data(), data.size());
+
+  EncodedDescriptorDatabase db;
+  EXPECT_TRUE(db.AddFileDescriptorSet(std::move(buffer)));
+
+  // The database keeps the buffer alive.
+  FileDescriptorProto file;
+  EXPECT_TRUE(db.FindFileContainingSymbol("foo.Foo", &file));
+  EXPECT_EQ(foo->DebugString(), file.DebugString());
+  EXPECT_TRUE(db.FindFileByName("bar.proto", &file));
+  EXPECT_EQ(bar->DebugString(), file.DebugString());
+
+  // Truncated in the middle of a file.
+  buffer.data.reset(new uint8_t[data.size()]);
+  buffer.size = static_cast<int>(data.size()) - 1;
+  memcpy(buffer.data.get(), data.data(), data.size());
+  EncodedDescriptorDatabase truncated_db;
+  EXPECT_FALSE(truncated_db.AddFileDescriptorSet(std::move(buffer)));
+  EXPECT_TRUE(truncated_db.FindFileByName("foo.proto", &file));
+  EXPECT_FALSE(truncated_db.FindFileByName("bar.proto", &file));
+}
+
+TEST(EncodedDescriptorDatabaseExtraTest, Snapshot) {
+  DescriptorPool pool;
+  FileDescriptorProto file_proto;
+  ASSERT_TRUE(TextFormat::ParseFromString(
+      "name: 'foo.proto' package: 'foo' message_type { name: 'Foo' }",
+      &file_proto));
+  ASSERT_TRUE(pool.BuildFile(file_proto) != nullptr);
+  ASSERT_TRUE(TextFormat::ParseFromString(
+      "name: 'bar.proto' package: 'bar' dependency: 'foo.proto' "
+      "message_type { "
+      "  name: 'Bar' "
+      "  field { name: 'foo' number: 1 label: LABEL_OPTIONAL "
+      "          type: TYPE_MESSAGE type_name: '.foo.Foo' } "
+      "}",
+      &file_proto));
+  const FileDescriptor* bar = pool.BuildFile(file_proto);
+  ASSERT_TRUE(bar != nullptr);
+
+  std::string data;
+  {
+    io::StringOutputStream output(&data);
+    EXPECT_TRUE(EncodedDescriptorDatabase::WriteSnapshot({bar, bar}, &output));
+  }
+  // Dependencies come first.
+  FileDescriptorSet set;
+  ASSERT_TRUE(set.ParseFromString(data));
+  ASSERT_EQ(2, set.file_size());
+  EXPECT_EQ("foo.proto", set.file(0).name());
+  EXPECT_EQ("bar.proto", set.file(1).name());
+
+  std::string filename = TestTempDir() + "/descriptor_snapshot.pb";
+  ASSERT_TRUE(File::SetContents(filename, data, true));
+  EncodedDescriptorDatabase db;
+  ASSERT_TRUE(db.AddSnapshot(filename));
+
+  DescriptorPool snapshot_pool(&db);
+  const Descriptor* snapshot_bar =
+      snapshot_pool.FindMessageTypeByName("bar.Bar");
+  ASSERT_TRUE(snapshot_bar != nullptr);
+  EXPECT_EQ(bar->DebugString(), snapshot_bar->file()->DebugString());
+  EXPECT_EQ("foo.Foo", snapshot_bar->field(0)->message_type()->full_name());
+
+  EXPECT_FALSE(db.AddSnapshot(TestTempDir() + "/no_such_snapshot.pb"));
+}
+
+TEST(EncodedDescriptorDatabaseExtraTest, SnapshotIndex) {
+  DescriptorPool pool;
+  FileDescriptorProto file_proto;
+  ASSERT_TRUE(TextFormat::ParseFromString(
+      "name: 'foo.proto' package: 'foo' "
+      "message_type { name: 'Foo' extension_range { start: 1 end: 100 } } "
+      "enum_type { name: 'FooEnum' value { name: 'FOO' number: 0 } }",
+      &file_proto));
+  ASSERT_TRUE(pool.BuildFile(file_proto) != nullptr);
+  ASSERT_TRUE(TextFormat::ParseFromString(
+      "name: 'bar.proto' package: 'bar' dependency: 'foo.proto' "
+      "message_type { "
+      "  name: 'Bar' "
+      "  extension { name: 'nested' number: 7 label: LABEL_OPTIONAL "
+      "              type: TYPE_INT32 extendee: '.foo.Foo' } "
+      "} "
+      "extension { name: 'top' number: 5 label: LABEL_OPTIONAL "
+      "            type: TYPE_INT32 extendee: '.foo.Foo' } "
+      "service { name: 'BarService' }",
+      &file_proto));
+  const FileDescriptor* bar = pool.BuildFile(file_proto);
+  ASSERT_TRUE(bar != nullptr);
+
+  std::string data;
+  {
+    io::StringOutputStream output(&data);
+    EXPECT_TRUE(EncodedDescriptorDatabase::WriteSnapshot({bar}, &output));
+  }
+  std::string filename = TestTempDir() + "/descriptor_snapshot_index.pb";
+  ASSERT_TRUE(File::SetContents(filename, data, true));
+  EncodedDescriptorDatabase db;
+  ASSERT_TRUE(db.AddSnapshot(filename));
+
+  FileDescriptorProto file;
+  std::string name;
+  EXPECT_TRUE(db.FindFileByName("bar.proto", &file));
+  EXPECT_EQ("bar.proto", file.name());
+  EXPECT_FALSE(db.FindFileByName("baz.proto", &file));
+  EXPECT_TRUE(db.FindNameOfFileContainingSymbol("foo.Foo", &name));
+  EXPECT_EQ("foo.proto", name);
+  EXPECT_TRUE(db.FindNameOfFileContainingSymbol("foo.FooEnum.FOO", &name));
+  EXPECT_EQ("foo.proto", name);
+  EXPECT_TRUE(db.FindNameOfFileContainingSymbol("bar.Bar.nested", &name));
+  EXPECT_EQ("bar.proto", name);
+  EXPECT_TRUE(db.FindFileContainingSymbol("bar.BarService", &file));
+  EXPECT_EQ("bar.proto", file.name());
+  EXPECT_FALSE(db.FindNameOfFileContainingSymbol("foo.Fo", &name));
+  EXPECT_FALSE(db.FindNameOfFileContainingSymbol("foo.FooBar", &name));
+  EXPECT_FALSE(db.FindNameOfFileContainingSymbol("baz.Baz", &name));
+
+  EXPECT_TRUE(db.FindFileContainingExtension("foo.Foo", 5, &file));
+  EXPECT_EQ("bar.proto", file.name());
+  EXPECT_TRUE(db.FindFileContainingExtension("foo.Foo", 7, &file));
+  EXPECT_EQ("bar.proto", file.name());
+  EXPECT_FALSE(db.FindFileContainingExtension("foo.Foo", 6, &file));
+  std::vector<int> numbers;
+  EXPECT_TRUE(db.FindAllExtensionNumbers("foo.Foo", &numbers));
+  EXPECT_THAT(numbers, testing::ElementsAre(5, 7));
+  EXPECT_FALSE(db.FindAllExtensionNumbers("bar.Bar", &numbers));
+
+  std::vector<std::string> names;
+  EXPECT_TRUE(db.FindAllFileNames(&names));
+  EXPECT_THAT(names, testing::ElementsAre("bar.proto", "foo.proto"));
+
+  // A plain FileDescriptorSet is added without an index.
+  FileDescriptorSet set;
+  ASSERT_TRUE(set.ParseFromString(data));
+  ASSERT_TRUE(File::SetContents(filename, set.SerializeAsString(), true));
+  EncodedDescriptorDatabase plain_db;
+  ASSERT_TRUE(plain_db.AddSnapshot(filename));
+  EXPECT_TRUE(plain_db.FindNameOfFileContainingSymbol("bar.Bar", &name));
+  EXPECT_EQ("bar.proto", name);
+
+  // A truncated index is rejected.
+  ASSERT_TRUE(File::SetContents(filename, data.substr(0, 20), true));
+  EncodedDescriptorDatabase truncated_db;
+  EXPECT_FALSE(truncated_db.AddSnapshot(filename));
+}
+
 TEST(SimpleDescriptorDatabaseExtraTest, FindAllFileNames) {
   FileDescriptorProto f;
   f.set_name("foo.proto");
@@ -36,6 +36,7 @@
 
 #include <limits>
 #include <memory>
+#include <thread>
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
@@ -7465,6 +7466,78 @@ TEST_F(DatabaseBackedPoolTest, DoesntFallbackOnWrongType) {
   EXPECT_EQ(0, call_counter.call_count_);
 }
 
+TEST_F(DatabaseBackedPoolTest, RolledBackSymbolsStayHidden) {
+  // Lookups of names that have been loaded skip the mutex.  Names of a file
+  // that failed to build must not be found that way, neither before nor after
+  // other files have been committed.
+  CallCountingDatabase call_counter(&database_);
+  DescriptorPool pool(&call_counter);
+
+  EXPECT_TRUE(pool.FindMessageTypeByName("Baz") == nullptr);
+  const Descriptor* bar = pool.FindMessageTypeByName("Bar");
+  ASSERT_TRUE(bar != nullptr);
+  EXPECT_TRUE(pool.FindMessageTypeByName("Baz") == nullptr);
+  EXPECT_TRUE(pool.FindFileByName("baz.proto") == nullptr);
+
+  call_counter.Clear();
+  EXPECT_EQ(bar, pool.FindMessageTypeByName("Bar"));
+  EXPECT_EQ(bar->file(), pool.FindFileByName("bar.proto"));
+  EXPECT_EQ(pool.FindMessageTypeByName("Foo"),
+            bar->file()->dependency(0)->message_type(0));
+  EXPECT_EQ(0, call_counter.call_count_);
+
+  // Baz is retried, and fails again.
+  EXPECT_TRUE(pool.FindMessageTypeByName("Baz") == nullptr);
+  EXPECT_NE(0, call_counter.call_count_);
+}
+
+TEST_F(DatabaseBackedPoolTest, ConcurrentLookups) {
+  // Threads race to load unittest.proto and its dependencies through the
+  // fallback database while others find what has already been loaded.
+  const FileDescriptor* original_file =
+      protobuf_unittest::TestAllTypes::descriptor()->file();
+  std::vector<std::string> names;
+  for (int i = 0; i < original_file->message_type_count(); i++) {
+    const Descriptor* message = original_file->message_type(i);
+    names.push_back(message->full_name());
+    for (int j = 0; j < message->nested_type_count(); j++) {
+      names.push_back(message->nested_type(j)->full_name());
+    }
+  }
+
+  DescriptorPoolDatabase database(*DescriptorPool::generated_pool());
+  DescriptorPool pool(&database);
+
+  const int kThreads = 8;
+  std::vector<std::vector<const Descriptor*>> found(kThreads);
+  std::vector<const FileDescriptor*> files(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      found[t].resize(names.size());
+      for (int round = 0; round < 10; round++) {
+        // Each thread walks the names from a different starting point.
+        for (size_t i = 0; i < names.size(); i++) {
+          size_t k = (i + t * names.size() / kThreads) % names.size();
+          found[t][k] = pool.FindMessageTypeByName(names[k]);
+        }
+      }
+      files[t] = pool.FindFileByName(original_file->name());
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (int t = 0; t < kThreads; t++) {
+    ASSERT_TRUE(files[t] != nullptr);
+    EXPECT_EQ(files[0], files[t]);
+    for (size_t k = 0; k < names.size(); k++) {
+      ASSERT_TRUE(found[t][k] != nullptr) << names[k];
+      EXPECT_EQ(names[k], found[t][k]->full_name());
+      EXPECT_EQ(found[0][k], found[t][k]);
+    }
+  }
+}
+
 // ===================================================================
 
 class AbortingErrorCollector : public DescriptorPool::ErrorCollector {
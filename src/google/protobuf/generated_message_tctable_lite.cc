@@ -1085,19 +1085,22 @@ const char* TcParser::PackedVarint(PROTOBUF_TC_PARAM_DECL) {
   // pending hasbits now:
   SyncHasbits(msg, hasbits, table);
   auto* field = &RefAt<RepeatedField<FieldType>>(msg, data.offset());
-  return ctx->ReadPackedVarint(ptr, [field](uint64_t varint) {
-    FieldType val;
-    if (zigzag) {
-      if (sizeof(FieldType) == 8) {
-        val = WireFormatLite::ZigZagDecode64(varint);
-      } else {
-        val = WireFormatLite::ZigZagDecode32(varint);
-      }
-    } else {
-      val = varint;
-    }
-    field->Add(val);
-  });
+  return ctx->ReadPackedVarint(
+      ptr,
+      [field](uint64_t varint) {
+        FieldType val;
+        if (zigzag) {
+          if (sizeof(FieldType) == 8) {
+            val = WireFormatLite::ZigZagDecode64(varint);
+          } else {
+            val = WireFormatLite::ZigZagDecode32(varint);
+          }
+        } else {
+          val = varint;
+        }
+        field->Add(val);
+      },
+      [field](int count) { field->Reserve(field->size() + count); });
 }
 
 PROTOBUF_NOINLINE const char* TcParser::FastV8P1(PROTOBUF_TC_PARAM_DECL) {
@@ -2083,9 +2086,12 @@ PROTOBUF_NOINLINE const char* TcParser::MpPackedVarint(PROTOBUF_TC_PARAM_DECL) {
   uint16_t rep = type_card & field_layout::kRepMask;
   if (rep == field_layout::kRep64Bits) {
     auto* field = &RefAt<RepeatedField<uint64_t>>(msg, entry.offset);
-    return ctx->ReadPackedVarint(ptr, [field, is_zigzag](uint64_t value) {
-      field->Add(is_zigzag ? WireFormatLite::ZigZagDecode64(value) : value);
-    });
+    return ctx->ReadPackedVarint(
+        ptr,
+        [field, is_zigzag](uint64_t value) {
+          field->Add(is_zigzag ? WireFormatLite::ZigZagDecode64(value) : value);
+        },
+        [field](int count) { field->Reserve(field->size() + count); });
   } else if (rep == field_layout::kRep32Bits) {
     auto* field = &RefAt<RepeatedField<uint32_t>>(msg, entry.offset);
     if (is_validated_enum) {
@@ -2098,17 +2104,21 @@ PROTOBUF_NOINLINE const char* TcParser::MpPackedVarint(PROTOBUF_TC_PARAM_DECL) {
         }
       });
     } else {
-      return ctx->ReadPackedVarint(ptr, [field, is_zigzag](uint64_t value) {
-        field->Add(is_zigzag ? WireFormatLite::ZigZagDecode32(
-                                   static_cast<uint32_t>(value))
-                             : value);
-      });
+      return ctx->ReadPackedVarint(
+          ptr,
+          [field, is_zigzag](uint64_t value) {
+            field->Add(is_zigzag ? WireFormatLite::ZigZagDecode32(
+                                       static_cast<uint32_t>(value))
+                                 : value);
+          },
+          [field](int count) { field->Reserve(field->size() + count); });
     }
   } else {
     GOOGLE_DCHECK_EQ(rep, static_cast<uint16_t>(field_layout::kRep8Bits));
     auto* field = &RefAt<RepeatedField<bool>>(msg, entry.offset);
     return ctx->ReadPackedVarint(
-        ptr, [field](uint64_t value) { field->Add(value); });
+        ptr, [field](uint64_t value) { field->Add(value); },
+        [field](int count) { field->Reserve(field->size() + count); });
   }
 
   return Error(PROTOBUF_TC_PARAM_PASS);
@@ -880,6 +880,21 @@ class PROTOBUF_EXPORT EpsCopyOutputStream {
     auto end = it + r.size();
     do {
       ptr = EnsureSpace(ptr);
+      // EnsureSpace leaves at least kSlopBytes of room. Runs of small values
+      // are common in packed fields, so when the next eight values all encode
+      // to a single byte write them as one block without per-value checks.
+      if (end - it >= 8) {
+        uint64_t any = 0;
+        for (int i = 0; i < 8; i++) any |= encode(it[i]);
+        if (any < 0x80) {
+          for (int i = 0; i < 8; i++) {
+            ptr[i] = static_cast<uint8_t>(encode(it[i]));
+          }
+          ptr += 8;
+          it += 8;
+          continue;
+        }
+      }
       ptr = UnsafeVarint(encode(*it++), ptr);
     } while (it < end);
     return ptr;
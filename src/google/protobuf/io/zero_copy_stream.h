@@ -124,7 +124,7 @@ class ZeroCopyOutputStream;
 
 struct RefCountBuffer {
   std::shared_ptr<uint8_t[]> data;
-  int size;
+  int size = 0;
 };
 
 // Abstract interface similar to an input stream but designed to minimize
@@ -188,6 +188,9 @@ class PROTOBUF_EXPORT ZeroCopyInputStream {
   // Returns the total number of bytes read since this object was created.
   virtual int64_t ByteCount() const = 0;
 
+  // Returns a reference-counted handle to the buffer most recently returned
+  // by Next(), which lazily parsed fields may hold on to instead of copying
+  // the bytes out.  Only meaningful if AllowsSharedBuffers() is true.
   virtual RefCountBuffer GetSharedBuffer() const {
     return {
       .data = NULL,
@@ -195,6 +198,12 @@ class PROTOBUF_EXPORT ZeroCopyInputStream {
     };
   }
 
+  // Returns true if GetSharedBuffer() is implemented, i.e. the buffers this
+  // stream returns from Next() stay valid for as long as the RefCountBuffer
+  // referring to them is held, even after further calls to Next() or after
+  // the stream is destroyed.
+  virtual bool AllowsSharedBuffers() const { return false; }
+
 };
 
 // Abstract interface similar to an output stream but designed to minimize
@@ -38,10 +38,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 #endif
+#ifndef _WIN32
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
 #include <errno.h>
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <vector>
 
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/stubs/logging.h"
@@ -96,6 +103,10 @@ bool FileInputStream::Skip(int count) { return impl_.Skip(count); }
 
 int64_t FileInputStream::ByteCount() const { return impl_.ByteCount(); }
 
+RefCountBuffer FileInputStream::GetSharedBuffer() const {
+  return impl_.GetSharedBuffer();
+}
+
 FileInputStream::CopyingFileInputStream::CopyingFileInputStream(
     int file_descriptor)
     : file_(file_descriptor),
@@ -169,6 +180,120 @@ int FileInputStream::CopyingFileInputStream::Skip(int count) {
 
 // ===================================================================
 
+MmapInputStream::MmapInputStream(int file_descriptor, int block_size)
+    : size_(0),
+      block_size_(block_size > 0 ? block_size
+                                 : std::numeric_limits<int>::max()),
+      position_(0),
+      chunk_start_(0),
+      last_returned_size_(0),
+      errno_(0) {
+#ifndef _WIN32
+  struct stat st;
+  if (fstat(file_descriptor, &st) != 0) {
+    errno_ = errno;
+    return;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    errno_ = ENODEV;
+    return;
+  }
+  const off_t offset = lseek(file_descriptor, 0, SEEK_CUR);
+  if (offset == (off_t)-1) {
+    errno_ = errno;
+    return;
+  }
+  // An empty mapping is invalid; there is simply nothing to read.
+  if (offset >= st.st_size) return;
+
+  // mmap() offsets must be page aligned.
+  const off_t page_size = sysconf(_SC_PAGESIZE);
+  const off_t map_offset = offset - offset % page_size;
+  const size_t map_size = static_cast<size_t>(st.st_size - map_offset);
+  void* mapping = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE,
+                       file_descriptor, map_offset);
+  if (mapping == MAP_FAILED) {
+    errno_ = errno;
+    return;
+  }
+  madvise(mapping, map_size, MADV_SEQUENTIAL);
+  std::shared_ptr<uint8_t[]> owner(
+      static_cast<uint8_t*>(mapping),
+      [map_size](uint8_t* p) { munmap(p, map_size); });
+  data_ =
+      std::shared_ptr<uint8_t[]>(owner, owner.get() + (offset - map_offset));
+  size_ = st.st_size - offset;
+#else
+  // No mmap() on Windows: read the rest of the file into memory instead.
+  std::vector<uint8_t> contents;
+  uint8_t buffer[8192];
+  int result;
+  do {
+    result = read(file_descriptor, buffer, sizeof(buffer));
+    if (result > 0) contents.insert(contents.end(), buffer, buffer + result);
+  } while (result > 0 || (result < 0 && errno == EINTR));
+  if (result < 0) {
+    errno_ = errno;
+    return;
+  }
+  size_ = static_cast<int64_t>(contents.size());
+  data_.reset(new uint8_t[contents.size()]);
+  std::copy(contents.begin(), contents.end(), data_.get());
+#endif
+}
+
+MmapInputStream::~MmapInputStream() = default;
+
+bool MmapInputStream::Next(const void** data, int* size) {
+  if (position_ < size_) {
+    last_returned_size_ =
+        static_cast<int>(std::min<int64_t>(block_size_, size_ - position_));
+    chunk_start_ = position_;
+    *data = data_.get() + position_;
+    *size = last_returned_size_;
+    position_ += last_returned_size_;
+    return true;
+  } else {
+    // We're at the end of the file.
+    last_returned_size_ = 0;  // Don't let caller back up.
+    return false;
+  }
+}
+
+void MmapInputStream::BackUp(int count) {
+  GOOGLE_CHECK_GT(last_returned_size_, 0)
+      << "BackUp() can only be called after a successful Next().";
+  GOOGLE_CHECK_LE(count, last_returned_size_);
+  GOOGLE_CHECK_GE(count, 0);
+  position_ -= count;
+  last_returned_size_ = 0;  // Don't let caller back up further.
+}
+
+bool MmapInputStream::Skip(int count) {
+  GOOGLE_CHECK_GE(count, 0);
+  last_returned_size_ = 0;  // Don't let caller back up.
+  if (count > size_ - position_) {
+    position_ = size_;
+    return false;
+  } else {
+    position_ += count;
+    return true;
+  }
+}
+
+int64_t MmapInputStream::ByteCount() const { return position_; }
+
+RefCountBuffer MmapInputStream::GetSharedBuffer() const {
+  // The chunk returned by the last Next(), sharing ownership of the mapping.
+  RefCountBuffer buffer;
+  buffer.data = std::shared_ptr<uint8_t[]>(data_, data_.get() + chunk_start_);
+  buffer.size = static_cast<int>(
+      std::min<int64_t>(block_size_, size_ - chunk_start_));
+  return buffer;
+}
+
+// ===================================================================
+
 FileOutputStream::FileOutputStream(int file_descriptor, int /*block_size*/)
     : CopyingOutputStreamAdaptor(&copying_output_),
       copying_output_(file_descriptor) {}
@@ -247,6 +372,171 @@ bool FileOutputStream::CopyingFileOutputStream::Write(const void* buffer,
 
 // ===================================================================
 
+namespace {
+constexpr int kDefaultVectoredBlockSize = 64 << 10;
+constexpr int64_t kDefaultVectoredMaxBufferedBytes = 1 << 20;
+}  // namespace
+
+VectoredFileOutputStream::VectoredFileOutputStream(int file_descriptor,
+                                                   int block_size,
+                                                   int64_t max_buffered_bytes)
+    : file_(file_descriptor),
+      block_size_(block_size > 0 ? block_size : kDefaultVectoredBlockSize),
+      max_buffered_bytes_(max_buffered_bytes > 0
+                              ? max_buffered_bytes
+                              : kDefaultVectoredMaxBufferedBytes),
+      close_on_delete_(false),
+      is_closed_(false),
+      errno_(0),
+      failed_(false),
+      num_pending_blocks_(0),
+      pending_bytes_(0),
+      bytes_written_(0),
+      last_returned_size_(0) {}
+
+VectoredFileOutputStream::~VectoredFileOutputStream() {
+  if (is_closed_) return;
+  Flush();
+  if (close_on_delete_) {
+    if (!Close()) {
+      GOOGLE_LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  }
+}
+
+bool VectoredFileOutputStream::Close() {
+  GOOGLE_CHECK(!is_closed_);
+
+  bool flush_succeeded = Flush();
+  is_closed_ = true;
+  if (close_no_eintr(file_) != 0) {
+    errno_ = errno;
+    return false;
+  }
+  return flush_succeeded;
+}
+
+bool VectoredFileOutputStream::Next(void** data, int* size) {
+  if (failed_) return false;
+
+  if (num_pending_blocks_ > 0) {
+    Block& current = blocks_[num_pending_blocks_ - 1];
+    if (current.used < block_size_) {
+      last_returned_size_ = block_size_ - current.used;
+      *data = current.data.get() + current.used;
+      *size = last_returned_size_;
+      current.used = block_size_;
+      pending_bytes_ += last_returned_size_;
+      return true;
+    }
+  }
+
+  if (pending_bytes_ >= max_buffered_bytes_ && !Flush()) return false;
+
+  if (num_pending_blocks_ == static_cast<int>(blocks_.size())) {
+    blocks_.push_back(
+        Block{std::unique_ptr<uint8_t[]>(new uint8_t[block_size_]), 0});
+  }
+  Block& block = blocks_[num_pending_blocks_++];
+  block.used = block_size_;
+  last_returned_size_ = block_size_;
+  pending_bytes_ += block_size_;
+  *data = block.data.get();
+  *size = block_size_;
+  return true;
+}
+
+void VectoredFileOutputStream::BackUp(int count) {
+  GOOGLE_CHECK_GT(last_returned_size_, 0)
+      << "BackUp() can only be called after a successful Next().";
+  GOOGLE_CHECK_LE(count, last_returned_size_);
+  GOOGLE_CHECK_GE(count, 0);
+  blocks_[num_pending_blocks_ - 1].used -= count;
+  pending_bytes_ -= count;
+  last_returned_size_ = 0;  // Don't let caller back up further.
+}
+
+int64_t VectoredFileOutputStream::ByteCount() const {
+  return bytes_written_ + pending_bytes_;
+}
+
+bool VectoredFileOutputStream::Flush() {
+  if (failed_) return false;
+  int64_t written = 0;
+  if (!WritePendingBlocks(&written)) {
+    // Whatever was not written is lost; the stream is broken from now on.
+    failed_ = true;
+  }
+  bytes_written_ += written;
+  num_pending_blocks_ = 0;
+  pending_bytes_ = 0;
+  last_returned_size_ = 0;
+  return !failed_;
+}
+
+bool VectoredFileOutputStream::WritePendingBlocks(int64_t* written) {
+  GOOGLE_CHECK(!is_closed_);
+#ifndef _WIN32
+  // Gather everything into one writev(), split only by IOV_MAX and by
+  // partial writes.
+  std::vector<iovec> iov;
+  iov.reserve(num_pending_blocks_);
+  for (int i = 0; i < num_pending_blocks_; ++i) {
+    if (blocks_[i].used == 0) continue;
+    iov.push_back(
+        {blocks_[i].data.get(), static_cast<size_t>(blocks_[i].used)});
+  }
+  size_t index = 0;
+  while (index < iov.size()) {
+    const int count = static_cast<int>(
+        std::min<size_t>(iov.size() - index, IOV_MAX));
+    ssize_t bytes;
+    do {
+      bytes = writev(file_, &iov[index], count);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes <= 0) {
+      // See CopyingFileOutputStream::Write() about zero-byte writes.
+      if (bytes < 0) errno_ = errno;
+      return false;
+    }
+    *written += bytes;
+    // Skip what was written.
+    while (bytes > 0) {
+      if (static_cast<size_t>(bytes) >= iov[index].iov_len) {
+        bytes -= iov[index].iov_len;
+        ++index;
+      } else {
+        iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + bytes;
+        iov[index].iov_len -= bytes;
+        bytes = 0;
+      }
+    }
+  }
+  return true;
+#else
+  for (int i = 0; i < num_pending_blocks_; ++i) {
+    const uint8_t* data = blocks_[i].data.get();
+    int remaining = blocks_[i].used;
+    while (remaining > 0) {
+      int bytes;
+      do {
+        bytes = write(file_, data, remaining);
+      } while (bytes < 0 && errno == EINTR);
+      if (bytes <= 0) {
+        if (bytes < 0) errno_ = errno;
+        return false;
+      }
+      *written += bytes;
+      data += bytes;
+      remaining -= bytes;
+    }
+  }
+  return true;
+#endif
+}
+
+// ===================================================================
+
 IstreamInputStream::IstreamInputStream(std::istream* input, int block_size)
     : copying_input_(input), impl_(&copying_input_, block_size) {}
 
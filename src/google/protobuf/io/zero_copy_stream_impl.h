@@ -41,7 +41,9 @@
 #define GOOGLE_PROTOBUF_IO_ZERO_COPY_STREAM_IMPL_H__
 
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/io/zero_copy_stream.h"
@@ -91,11 +93,16 @@ class PROTOBUF_EXPORT FileInputStream PROTOBUF_FUTURE_FINAL
   // fail.
   int GetErrno() const { return copying_input_.GetErrno(); }
 
+  // See CopyingInputStreamAdaptor::SetBufferPool().
+  void SetBufferPool(RefCountBufferPool* pool) { impl_.SetBufferPool(pool); }
+
   // implements ZeroCopyInputStream ----------------------------------
   bool Next(const void** data, int* size) override;
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
+  RefCountBuffer GetSharedBuffer() const override;
+  bool AllowsSharedBuffers() const override { return true; }
 
  private:
   class PROTOBUF_EXPORT CopyingFileInputStream PROTOBUF_FUTURE_FINAL
@@ -134,6 +141,58 @@ class PROTOBUF_EXPORT FileInputStream PROTOBUF_FUTURE_FINAL
 
 // ===================================================================
 
+// A ZeroCopyInputStream which memory-maps a file and returns chunks of the
+// mapping directly, without copying through an intermediate buffer.
+//
+// The file contents from the descriptor's current offset up to the end of
+// file are mapped read-only once, at construction; the descriptor itself is
+// neither read from nor repositioned and may be closed afterwards.  The
+// mapping is advised for sequential access.  Only regular files can be
+// mapped; for pipes and sockets use FileInputStream.  On platforms without
+// mmap() the remaining file contents are read into memory instead.
+//
+// GetSharedBuffer() hands out references to the mapping, so buffers aliased
+// from it (e.g. by lazily parsed fields) keep it alive after the stream is
+// destroyed.
+class PROTOBUF_EXPORT MmapInputStream PROTOBUF_FUTURE_FINAL
+    : public ZeroCopyInputStream {
+ public:
+  // Creates a stream over the given Unix file descriptor.  If a block_size
+  // is given, it bounds the number of bytes returned by each call to Next().
+  // Otherwise, chunks are as large as possible.
+  explicit MmapInputStream(int file_descriptor, int block_size = -1);
+  MmapInputStream(const MmapInputStream&) = delete;
+  MmapInputStream& operator=(const MmapInputStream&) = delete;
+  ~MmapInputStream() override;
+
+  // If mapping the file failed, this is the errno from that error.
+  // Otherwise, this is zero.  A stream that failed to map returns no data.
+  int GetErrno() const { return errno_; }
+
+  // implements ZeroCopyInputStream ----------------------------------
+  bool Next(const void** data, int* size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64_t ByteCount() const override;
+  RefCountBuffer GetSharedBuffer() const override;
+  bool AllowsSharedBuffers() const override { return true; }
+
+ private:
+  // The mapped (or read) file contents.  The shared_ptr's deleter releases
+  // the mapping once the stream and all shared buffers are gone.
+  std::shared_ptr<uint8_t[]> data_;
+  int64_t size_;
+  const int block_size_;
+
+  int64_t position_;
+  int64_t chunk_start_;     // Where the chunk last returned by Next() starts.
+  int last_returned_size_;  // How many bytes we returned last time Next()
+                            // was called (used for error checking only).
+  int errno_;
+};
+
+// ===================================================================
+
 // A ZeroCopyOutputStream which writes to a file descriptor.
 //
 // FileOutputStream is preferred over using an ofstream with
@@ -203,6 +262,86 @@ class PROTOBUF_EXPORT FileOutputStream PROTOBUF_FUTURE_FINAL
 
 // ===================================================================
 
+// A ZeroCopyOutputStream which writes to a file descriptor, gathering all
+// buffered blocks into a single writev() call.
+//
+// FileOutputStream writes each buffer out as soon as it is full.  This stream
+// instead keeps filling fresh blocks and only writes when Flush() is called
+// (or when more than max_buffered_bytes are pending), so producers of many
+// small records pay one system call per batch rather than one per buffer.
+// Blocks are reused after each flush.
+class PROTOBUF_EXPORT VectoredFileOutputStream PROTOBUF_FUTURE_FINAL
+    : public ZeroCopyOutputStream {
+ public:
+  // Creates a stream that writes to the given Unix file descriptor.  If a
+  // block_size is given, it specifies the size of the buffers returned by
+  // Next().  If max_buffered_bytes is given, pending data is written out
+  // automatically once it reaches that size.  Otherwise, reasonable defaults
+  // are used.
+  explicit VectoredFileOutputStream(int file_descriptor, int block_size = -1,
+                                    int64_t max_buffered_bytes = -1);
+  VectoredFileOutputStream(const VectoredFileOutputStream&) = delete;
+  VectoredFileOutputStream& operator=(const VectoredFileOutputStream&) =
+      delete;
+  ~VectoredFileOutputStream() override;
+
+  // Writes all pending data.  Buffers previously returned by Next() must not
+  // be used afterwards.  Returns false if an error occurs; use GetErrno() to
+  // examine the error.
+  bool Flush();
+
+  // Flushes and closes the underlying file.  Even if an error occurs, the
+  // file descriptor is closed when this returns.
+  bool Close();
+
+  // See FileOutputStream::SetCloseOnDelete().
+  void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
+
+  // If an I/O error has occurred on this file descriptor, this is the
+  // errno from that error.  Otherwise, this is zero.  Once an error
+  // occurs, the stream is broken and all subsequent operations will
+  // fail.
+  int GetErrno() const { return errno_; }
+
+  // implements ZeroCopyOutputStream ---------------------------------
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  int64_t ByteCount() const override;
+
+ private:
+  struct Block {
+    std::unique_ptr<uint8_t[]> data;
+    int used;
+  };
+
+  // Writes blocks_[0, num_pending_blocks_) out, adding the number of bytes
+  // actually written to *written.
+  bool WritePendingBlocks(int64_t* written);
+
+  const int file_;
+  const int block_size_;
+  const int64_t max_buffered_bytes_;
+  bool close_on_delete_;
+  bool is_closed_;
+
+  // The errno of the I/O error, if one has occurred.  Otherwise, zero.
+  int errno_;
+  // True if a write failed, with or without an errno (e.g. a zero-byte
+  // write).  Once set, nothing more is written.
+  bool failed_;
+
+  // All blocks ever allocated; the first num_pending_blocks_ hold data that
+  // has not been written yet.
+  std::vector<Block> blocks_;
+  int num_pending_blocks_;
+  int64_t pending_bytes_;
+  int64_t bytes_written_;
+  int last_returned_size_;  // How many bytes we returned last time Next()
+                            // was called (used for error checking only).
+};
+
+// ===================================================================
+
 // A ZeroCopyInputStream which reads from a C++ istream.
 //
 // Note that for reading files (or anything represented by a file descriptor),
@@ -218,12 +357,16 @@ class PROTOBUF_EXPORT IstreamInputStream PROTOBUF_FUTURE_FINAL
   IstreamInputStream(const IstreamInputStream&) = delete;
   IstreamInputStream& operator=(const IstreamInputStream&) = delete;
 
+  // See CopyingInputStreamAdaptor::SetBufferPool().
+  void SetBufferPool(RefCountBufferPool* pool) { impl_.SetBufferPool(pool); }
+
   // implements ZeroCopyInputStream ----------------------------------
   bool Next(const void** data, int* size) override;
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
   RefCountBuffer GetSharedBuffer() const override;
+  bool AllowsSharedBuffers() const override { return true; }
 
  private:
   class PROTOBUF_EXPORT CopyingIstreamInputStream PROTOBUF_FUTURE_FINAL
@@ -35,7 +35,9 @@
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 
 #include <algorithm>
+#include <atomic>
 #include <limits>
+#include <memory>
 #include <utility>
 
 #include "google/protobuf/stubs/common.h"
@@ -104,6 +106,18 @@ bool ArrayInputStream::Skip(int count) {
 
 int64_t ArrayInputStream::ByteCount() const { return position_; }
 
+RefCountBuffer ArrayInputStream::GetSharedBuffer() const {
+  GOOGLE_DCHECK(aliasing_enabled_);
+  // The caller guarantees the array's lifetime, so the handle does not own
+  // anything.  It covers the whole array, which includes every buffer that
+  // Next() has returned.
+  RefCountBuffer buffer;
+  buffer.data = std::shared_ptr<uint8_t[]>(std::shared_ptr<uint8_t[]>(),
+                                           const_cast<uint8_t*>(data_));
+  buffer.size = size_;
+  return buffer;
+}
+
 
 // ===================================================================
 
@@ -198,6 +212,59 @@ int CopyingInputStream::Skip(int count) {
   return skipped;
 }
 
+RefCountBufferPool::RefCountBufferPool(std::vector<int> size_classes,
+                                       int max_buffers_per_class)
+    : max_buffers_per_class_(max_buffers_per_class) {
+  GOOGLE_CHECK(!size_classes.empty());
+  std::sort(size_classes.begin(), size_classes.end());
+  for (int size : size_classes) {
+    GOOGLE_CHECK_GT(size, 0);
+    size_classes_.push_back({size, {}});
+  }
+}
+
+RefCountBuffer RefCountBufferPool::Get(int size) {
+  RefCountBuffer result;
+  auto it = std::lower_bound(
+      size_classes_.begin(), size_classes_.end(), size,
+      [](const SizeClass& size_class, int size) {
+        return size_class.size < size;
+      });
+  if (it == size_classes_.end()) {
+    result.data.reset(new uint8_t[size]);
+    result.size = size;
+    return result;
+  }
+
+  SizeClass& size_class = *it;
+  result.size = size_class.size;
+  absl::MutexLock lock(&mutex_);
+  // Scanning from the front reuses the same few, cache-warm buffers when
+  // they are released quickly.
+  for (const std::shared_ptr<uint8_t[]>& buffer : size_class.buffers) {
+    if (buffer.use_count() == 1) {
+      // The last other owner released the buffer with a release decrement;
+      // synchronize with it before the buffer is written to again.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      result.data = buffer;
+      return result;
+    }
+  }
+
+  result.data.reset(new uint8_t[size_class.size]);
+  if (size_class.buffers.size() < static_cast<size_t>(max_buffers_per_class_)) {
+    size_class.buffers.push_back(result.data);
+  }
+  return result;
+}
+
+RefCountBufferPool* RefCountBufferPool::Default() {
+  static auto* pool = new RefCountBufferPool({kDefaultBlockSize, 64 << 10});
+  return pool;
+}
+
+// ===================================================================
+
 CopyingInputStreamAdaptor::CopyingInputStreamAdaptor(
     CopyingInputStream* copying_stream, int block_size)
     : copying_stream_(copying_stream),
@@ -206,7 +273,8 @@ CopyingInputStreamAdaptor::CopyingInputStreamAdaptor(
       position_(0),
       buffer_size_(block_size > 0 ? block_size : kDefaultBlockSize),
       buffer_used_(0),
-      backup_bytes_(0) {}
+      backup_bytes_(0),
+      buffer_pool_(nullptr) {}
 
 CopyingInputStreamAdaptor::~CopyingInputStreamAdaptor() {
   if (owns_copying_stream_) {
@@ -297,7 +365,14 @@ RefCountBuffer CopyingInputStreamAdaptor::GetSharedBuffer() const {
 void CopyingInputStreamAdaptor::AllocateBufferIfNeeded() {
   if (buffer_.get() == NULL || need_reset_buffer_) {
     need_reset_buffer_ = false;
-    buffer_.reset(new uint8_t[buffer_size_]);
+    if (buffer_pool_ != nullptr) {
+      // Drop the old buffer first: if whoever shared it released it already,
+      // it can be reused right away.
+      buffer_.reset();
+      buffer_ = buffer_pool_->Get(buffer_size_).data;
+    } else {
+      buffer_.reset(new uint8_t[buffer_size_]);
+    }
   }
 }
 
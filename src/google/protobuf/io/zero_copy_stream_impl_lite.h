@@ -48,11 +48,13 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "google/protobuf/stubs/callback.h"
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/port.h"
+#include "absl/synchronization/mutex.h"
 
 
 // Must be included last.
@@ -87,7 +89,13 @@ class PROTOBUF_EXPORT ArrayInputStream PROTOBUF_FUTURE_FINAL
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
+  RefCountBuffer GetSharedBuffer() const override;
+  bool AllowsSharedBuffers() const override { return aliasing_enabled_; }
 
+  // Promises that "data" outlives not only this stream but also everything
+  // parsed from it.  Lazily parsed fields will then refer to the array
+  // directly instead of copying their bytes out of it.
+  void EnableAliasing(bool enabled) { aliasing_enabled_ = enabled; }
 
  private:
   const uint8_t* const data_;  // The byte array.
@@ -97,6 +105,7 @@ class PROTOBUF_EXPORT ArrayInputStream PROTOBUF_FUTURE_FINAL
   int position_;
   int last_returned_size_;  // How many bytes we returned last time Next()
                             // was called (used for error checking only).
+  bool aliasing_enabled_ = false;
 };
 
 // ===================================================================
@@ -173,6 +182,48 @@ class PROTOBUF_EXPORT StringOutputStream PROTOBUF_FUTURE_FINAL
 
 // ===================================================================
 
+// A thread-safe pool of reference-counted buffers, from which stream
+// adaptors allocate the buffers they hand out through GetSharedBuffer().
+//
+// Buffers come in a fixed set of size classes.  The pool keeps a reference to
+// each buffer it created, and a buffer is handed out again once every other
+// reference to it (e.g. one held by a lazily parsed field) has been dropped.
+// A size class keeps at most max_buffers_per_class buffers; beyond that, and
+// for sizes above the largest class, buffers are allocated and freed as
+// usual.
+class PROTOBUF_EXPORT RefCountBufferPool {
+ public:
+  // size_classes must be non-empty; it is sorted here.
+  explicit RefCountBufferPool(std::vector<int> size_classes,
+                              int max_buffers_per_class = 4);
+  ~RefCountBufferPool() = default;
+
+  // `RefCountBufferPool` is neither copiable nor assignable
+  RefCountBufferPool(const RefCountBufferPool&) = delete;
+  RefCountBufferPool& operator=(const RefCountBufferPool&) = delete;
+
+  // Returns a buffer of at least "size" bytes; its size is that of the
+  // smallest size class which fits.  Buffers held elsewhere stay valid after
+  // the pool is destroyed.
+  RefCountBuffer Get(int size);
+
+  // A process-wide pool for adaptors which opt in, with size classes of 8KB
+  // (the adaptor's default block size) and 64KB.  It retains at most 288KB.
+  static RefCountBufferPool* Default();
+
+ private:
+  struct SizeClass {
+    int size;
+    std::vector<std::shared_ptr<uint8_t[]>> buffers;
+  };
+
+  absl::Mutex mutex_;
+  std::vector<SizeClass> size_classes_;
+  const int max_buffers_per_class_;
+};
+
+// ===================================================================
+
 // A generic traditional input stream interface.
 //
 // Lots of traditional input streams (e.g. file descriptors, C stdio
@@ -229,12 +280,19 @@ class PROTOBUF_EXPORT CopyingInputStreamAdaptor : public ZeroCopyInputStream {
   // delete the underlying CopyingInputStream when it is destroyed.
   void SetOwnsCopyingStream(bool value) { owns_copying_stream_ = value; }
 
+  // Sets the pool read buffers are taken from; buffers captured through
+  // GetSharedBuffer() return to it once released.  Worth it when a lazily
+  // parsed message keeps references into the input.  By default (nullptr)
+  // every buffer is allocated anew.  The pool must outlive the adaptor.
+  void SetBufferPool(RefCountBufferPool* pool) { buffer_pool_ = pool; }
+
   // implements ZeroCopyInputStream ----------------------------------
   bool Next(const void** data, int* size) override;
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
   RefCountBuffer GetSharedBuffer() const override;
+  bool AllowsSharedBuffers() const override { return true; }
 
  private:
   // Insures that buffer_ is not NULL.
@@ -268,6 +326,8 @@ class PROTOBUF_EXPORT CopyingInputStreamAdaptor : public ZeroCopyInputStream {
   int backup_bytes_;
 
   mutable bool need_reset_buffer_ = false;
+
+  RefCountBufferPool* buffer_pool_;
 };
 
 // ===================================================================
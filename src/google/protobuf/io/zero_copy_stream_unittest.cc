@@ -59,6 +59,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <utility>
@@ -92,6 +93,7 @@ using google::protobuf::io::win32::access;
 using google::protobuf::io::win32::close;
 using google::protobuf::io::win32::mkdir;
 using google::protobuf::io::win32::open;
+using google::protobuf::io::win32::write;
 #endif
 
 #ifndef O_BINARY
@@ -769,6 +771,137 @@ TEST_F(IoTest, FileIo) {
   }
 }
 
+TEST_F(IoTest, VectoredFileIo) {
+  std::string filename = TestTempDir() + "/zero_copy_stream_test_file";
+
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    for (int j = 0; j < kBlockSizeCount; j++) {
+      // Make a temporary file.
+      int file =
+          open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0777);
+      ASSERT_GE(file, 0);
+
+      {
+        // A small buffering limit forces intermediate flushes.
+        VectoredFileOutputStream output(file, kBlockSizes[i], 10);
+        WriteStuff(&output);
+        EXPECT_TRUE(output.Flush());
+        EXPECT_EQ(0, output.GetErrno());
+      }
+
+      // Rewind.
+      ASSERT_NE(lseek(file, 0, SEEK_SET), (off_t)-1);
+
+      {
+        FileInputStream input(file, kBlockSizes[j]);
+        ReadStuff(&input);
+        EXPECT_EQ(0, input.GetErrno());
+      }
+
+      close(file);
+    }
+  }
+}
+
+TEST_F(IoTest, VectoredFileIoLarge) {
+  std::string filename = TestTempDir() + "/zero_copy_stream_test_file";
+  int file =
+      open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0777);
+  ASSERT_GE(file, 0);
+
+  {
+    // Everything stays buffered until the destructor flushes it, in many
+    // small blocks.
+    VectoredFileOutputStream output(file, 64, 1 << 30);
+    WriteStuffLarge(&output);
+    EXPECT_EQ(0, output.GetErrno());
+  }
+
+  ASSERT_NE(lseek(file, 0, SEEK_SET), (off_t)-1);
+  {
+    FileInputStream input(file);
+    ReadStuffLarge(&input);
+    EXPECT_EQ(0, input.GetErrno());
+  }
+  close(file);
+}
+
+TEST_F(IoTest, MmapIo) {
+  std::string filename = TestTempDir() + "/zero_copy_stream_test_file";
+  const std::string kPrefix = "skipped prefix";
+
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    for (int j = 0; j < kBlockSizeCount; j++) {
+      // Make a temporary file.
+      int file =
+          open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0777);
+      ASSERT_GE(file, 0);
+
+      ASSERT_EQ(write(file, kPrefix.data(), kPrefix.size()),
+                static_cast<int>(kPrefix.size()));
+      {
+        FileOutputStream output(file, kBlockSizes[i]);
+        WriteStuff(&output);
+        EXPECT_EQ(0, output.GetErrno());
+      }
+
+      // The mapping starts at the current offset, which need not be page
+      // aligned.
+      ASSERT_NE(lseek(file, kPrefix.size(), SEEK_SET), (off_t)-1);
+
+      {
+        MmapInputStream input(file, kBlockSizes[j]);
+        close(file);  // The mapping does not need the descriptor.
+        EXPECT_EQ(0, input.GetErrno());
+        ReadStuff(&input);
+      }
+    }
+  }
+}
+
+TEST_F(IoTest, MmapSharedBufferOutlivesStream) {
+  std::string filename = TestTempDir() + "/zero_copy_stream_test_file";
+  int file =
+      open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0777);
+  ASSERT_GE(file, 0);
+  {
+    FileOutputStream output(file);
+    WriteString(&output, "mapped contents");
+  }
+  ASSERT_NE(lseek(file, 0, SEEK_SET), (off_t)-1);
+
+  RefCountBuffer buffer;
+  {
+    MmapInputStream input(file, 6);
+    const void* data;
+    int size;
+    ASSERT_TRUE(input.Next(&data, &size));
+    ASSERT_TRUE(input.Next(&data, &size));
+    buffer = input.GetSharedBuffer();
+    EXPECT_EQ(data, buffer.data.get());
+    EXPECT_EQ(size, buffer.size);
+  }
+  close(file);
+  EXPECT_EQ(" conte",
+            std::string(reinterpret_cast<const char*>(buffer.data.get()),
+                        buffer.size));
+}
+
+TEST_F(IoTest, MmapEmptyFile) {
+  std::string filename = TestTempDir() + "/zero_copy_stream_test_file";
+  int file =
+      open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0777);
+  ASSERT_GE(file, 0);
+
+  MmapInputStream input(file);
+  close(file);
+  const void* data;
+  int size;
+  EXPECT_FALSE(input.Next(&data, &size));
+  EXPECT_EQ(0, input.GetErrno());
+  EXPECT_EQ(0, input.ByteCount());
+}
+
 #ifndef _WIN32
 // This tests the FileInputStream with a non blocking file. It opens a pipe in
 // non blocking mode, then starts reading it. The writing thread starts writing
@@ -914,6 +1047,30 @@ TEST_F(IoTest, FileReadError) {
   EXPECT_EQ(EBADF, input.GetErrno());
 }
 
+// Test that MmapInputStreams report errors correctly.
+TEST_F(IoTest, MmapReadError) {
+  MsvcDebugDisabler debug_disabler;
+
+  // -1 = invalid file descriptor.
+  MmapInputStream input(-1);
+
+  const void* buffer;
+  int size;
+  EXPECT_FALSE(input.Next(&buffer, &size));
+  EXPECT_EQ(EBADF, input.GetErrno());
+
+#ifndef _WIN32
+  // Pipes cannot be mapped.
+  int files[2];
+  ASSERT_EQ(pipe(files), 0);
+  MmapInputStream pipe_input(files[0]);
+  EXPECT_FALSE(pipe_input.Next(&buffer, &size));
+  EXPECT_EQ(ENODEV, pipe_input.GetErrno());
+  close(files[0]);
+  close(files[1]);
+#endif
+}
+
 // Test that FileOutputStreams report errors correctly.
 TEST_F(IoTest, FileWriteError) {
   MsvcDebugDisabler debug_disabler;
@@ -934,6 +1091,24 @@ TEST_F(IoTest, FileWriteError) {
   EXPECT_EQ(EBADF, input.GetErrno());
 }
 
+TEST_F(IoTest, VectoredFileWriteError) {
+  MsvcDebugDisabler debug_disabler;
+
+  // -1 = invalid file descriptor.
+  VectoredFileOutputStream output(-1);
+
+  void* buffer;
+  int size;
+  // Nothing is written until the stream is flushed.
+  EXPECT_TRUE(output.Next(&buffer, &size));
+  EXPECT_FALSE(output.Flush());
+  EXPECT_EQ(EBADF, output.GetErrno());
+  // The dropped block was never written.
+  EXPECT_EQ(0, output.ByteCount());
+  EXPECT_FALSE(output.Next(&buffer, &size));
+  EXPECT_FALSE(output.Flush());
+}
+
 // Pipes are not seekable, so File{Input,Output}Stream ends up doing some
 // different things to handle them.  We'll test by writing to a pipe and
 // reading back from it.
@@ -1002,6 +1177,93 @@ TEST_F(IoTest, IostreamIo) {
   }
 }
 
+TEST(RefCountBufferPoolTest, ReusesReleasedBuffers) {
+  RefCountBufferPool pool({1024, 64}, 2);
+
+  RefCountBuffer small = pool.Get(10);
+  EXPECT_EQ(small.size, 64);
+  RefCountBuffer large = pool.Get(65);
+  EXPECT_EQ(large.size, 1024);
+  RefCountBuffer oversized = pool.Get(2000);
+  EXPECT_EQ(oversized.size, 2000);
+
+  // A buffer still held elsewhere is not handed out again.
+  uint8_t* held = small.data.get();
+  RefCountBuffer other = pool.Get(64);
+  EXPECT_NE(other.data.get(), held);
+
+  small.data.reset();
+  RefCountBuffer reused = pool.Get(64);
+  EXPECT_EQ(reused.data.get(), held);
+
+  // The size class is full: further buffers are not retained by the pool.
+  RefCountBuffer unpooled = pool.Get(64);
+  RefCountBuffer unpooled_again = pool.Get(64);
+  EXPECT_EQ(unpooled.data.use_count(), 1);
+  EXPECT_NE(unpooled.data.get(), unpooled_again.data.get());
+}
+
+// Reads from a string with a copy, as a file or socket would.
+class StringCopyingInputStream : public CopyingInputStream {
+ public:
+  explicit StringCopyingInputStream(const std::string& data) : data_(data) {}
+
+  int Read(void* buffer, int size) override {
+    size = std::min<int>(size, data_.size() - position_);
+    memcpy(buffer, data_.data() + position_, size);
+    position_ += size;
+    return size;
+  }
+
+ private:
+  const std::string& data_;
+  size_t position_ = 0;
+};
+
+TEST(RefCountBufferPoolTest, CopyingInputStreamAdaptorRecyclesSharedBuffers) {
+  RefCountBufferPool pool({16}, 4);
+  std::string data;
+  for (int i = 0; i < 64; i++) data.push_back(static_cast<char>(i));
+  StringCopyingInputStream copying_input(data);
+  CopyingInputStreamAdaptor input(&copying_input, 16);
+  input.SetBufferPool(&pool);
+
+  // Capture the first buffer, as a lazily parsed field would.
+  const void* chunk;
+  int size;
+  ASSERT_TRUE(input.Next(&chunk, &size));
+  RefCountBuffer captured = input.GetSharedBuffer();
+  EXPECT_EQ(captured.data.get(), chunk);
+
+  // The captured buffer is not overwritten by the next read, and a buffer
+  // dropped by the adaptor is reused.
+  ASSERT_TRUE(input.Next(&chunk, &size));
+  EXPECT_NE(chunk, captured.data.get());
+  const void* second = chunk;
+  input.GetSharedBuffer();
+  ASSERT_TRUE(input.Next(&chunk, &size));
+  ASSERT_TRUE(input.Next(&chunk, &size));
+  EXPECT_EQ(chunk, second);
+  EXPECT_EQ(memcmp(captured.data.get(), data.data(), 16), 0);
+  EXPECT_EQ(memcmp(chunk, data.data() + 48, 16), 0);
+}
+
+TEST(RefCountBufferPoolTest, IstreamInputStreamUsesBufferPool) {
+  RefCountBufferPool pool({16}, 1);
+  std::string data(64, 'x');
+  std::istringstream stream(data);
+  IstreamInputStream input(&stream, 16);
+  input.SetBufferPool(&pool);
+
+  const void* chunk;
+  int size;
+  ASSERT_TRUE(input.Next(&chunk, &size));
+  RefCountBuffer pooled = pool.Get(16);
+  // The pool's only buffer is the one the stream is reading into.
+  EXPECT_NE(pooled.data.get(), chunk);
+  EXPECT_EQ(pooled.data.use_count(), 1);
+}
+
 // To test ConcatenatingInputStream, we create several ArrayInputStreams
 // covering a buffer and then concatenate them.
 TEST_F(IoTest, ConcatenatingInputStream) {
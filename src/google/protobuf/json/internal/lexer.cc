@@ -32,10 +32,19 @@
 
 #include <sys/types.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
 #include <atomic>
 #include <cfloat>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <ostream>
@@ -99,6 +108,151 @@ void HardenAgainstHyrumsLaw(absl::string_view to_obfuscate, std::string& out) {
     }
   }
 }
+
+// Kernels for scanning contiguous runs of the input buffer. These let the
+// lexer consume many bytes per call to ZeroCopyBufferedStream::Advance(),
+// rather than going through the buffering machinery once per character.
+
+// Returns true if `c` is JSON whitespace.
+bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Returns a pointer to the first byte in [p, end) that is not JSON whitespace,
+// or `end` if there is none.
+const char* SkipWhitespaceRun(const char* p, const char* end) {
+#if defined(__SSE2__)
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i tab = _mm_set1_epi8('\t');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, nl)),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, tab)));
+    uint32_t not_ws =
+        ~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & uint32_t{0xffff};
+    if (not_ws != 0) {
+      return p + absl::countr_zero(not_ws);
+    }
+    p += 16;
+  }
+#endif  // __SSE2__
+  while (p < end && IsJsonWhitespace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Returns a pointer to the first byte in [p, end) that is a quote, a
+// backslash, a control character or a non-ASCII byte, or `end` if there is
+// none.
+const char* SkipAsciiStringRun(const char* p, const char* end) {
+#if defined(__AVX2__)
+  {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    // Signed comparison: bytes >= 0x80 are negative, so this catches both
+    // control characters and non-ASCII bytes.
+    const __m256i space = _mm256_set1_epi8(0x20);
+    while (end - p >= 32) {
+      __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+      __m256i special = _mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                          _mm256_cmpeq_epi8(chunk, squote)),
+          _mm256_or_si256(_mm256_cmpeq_epi8(chunk, backslash),
+                          _mm256_cmpgt_epi8(space, chunk)));
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+      if (mask != 0) {
+        return p + absl::countr_zero(mask);
+      }
+      p += 32;
+    }
+  }
+#endif  // __AVX2__
+#if defined(__SSE2__)
+  {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    // Signed comparison, as above.
+    const __m128i space = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i special = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                       _mm_cmpeq_epi8(chunk, squote)),
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, backslash),
+                       _mm_cmplt_epi8(chunk, space)));
+      uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+      if (mask != 0) {
+        return p + absl::countr_zero(mask);
+      }
+      p += 16;
+    }
+  }
+#else   // __SSE2__
+  // Portable fallback: test eight bytes at a time for the presence of any
+  // special byte, and only then locate it one byte at a time.
+  constexpr uint64_t kOnes = 0x0101010101010101;
+  constexpr uint64_t kHighBits = 0x8080808080808080;
+  auto has_zero = [](uint64_t v) { return (v - kOnes) & ~v & kHighBits; };
+  while (end - p >= 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, p, sizeof(chunk));
+    uint64_t special = (chunk & kHighBits) |
+                       ((chunk - kOnes * 0x20) & ~chunk & kHighBits) |
+                       has_zero(chunk ^ (kOnes * '"')) |
+                       has_zero(chunk ^ (kOnes * '\'')) |
+                       has_zero(chunk ^ (kOnes * '\\'));
+    if (special != 0) {
+      break;
+    }
+    p += 8;
+  }
+#endif  // __SSE2__
+  for (; p < end; ++p) {
+    uint8_t c = static_cast<uint8_t>(*p);
+    if (c < 0x20 || c >= 0x80 || c == '"' || c == '\'' || c == '\\') {
+      break;
+    }
+  }
+  return p;
+}
+
+// Returns a pointer to the first byte in [p, end) that cannot be copied
+// verbatim into a decoded string: quotes, backslashes, control characters,
+// and anything that is not a complete UTF-8 sequence. Such bytes are left to
+// the lexer's slow path, which produces errors or handles sequences that
+// straddle a buffer boundary.
+//
+// The UTF-8 check here is exactly as lenient as the slow path in ParseUtf8():
+// it checks lead and continuation bits only.
+const char* SkipStringRun(const char* p, const char* end) {
+  while (true) {
+    p = SkipAsciiStringRun(p, end);
+    if (p == end) {
+      return p;
+    }
+
+    uint8_t c = static_cast<uint8_t>(*p);
+    if (c < 0x80) {
+      return p;
+    }
+    ptrdiff_t len = absl::countl_one(c);
+    if (len < 2 || len > 4 || end - p < len) {
+      return p;
+    }
+    for (ptrdiff_t i = 1; i < len; ++i) {
+      if ((static_cast<uint8_t>(p[i]) >> 6) != 2) {
+        return p;
+      }
+    }
+    p += len;
+  }
+}
 }  // namespace
 
 constexpr size_t ParseOptions::kDefaultDepth;
@@ -214,19 +368,26 @@ absl::StatusOr<uint16_t> JsonLexer::ParseU16HexCodepoint() {
 absl::Status JsonLexer::SkipToToken() {
   while (true) {
     RETURN_IF_ERROR(stream_.BufferAtLeast(1).status());
-    switch (stream_.PeekChar()) {
-      case '\n':
-        RETURN_IF_ERROR(Advance(1));
-        ++json_loc_.line;
-        json_loc_.col = 0;
-        break;
-      case '\r':
-      case '\t':
-      case ' ':
-        RETURN_IF_ERROR(Advance(1));
-        break;
-      default:
-        return absl::OkStatus();
+    absl::string_view unread = stream_.Unread();
+    const char* end =
+        SkipWhitespaceRun(unread.data(), unread.data() + unread.size());
+    size_t skipped = static_cast<size_t>(end - unread.data());
+    if (skipped == 0) {
+      return absl::OkStatus();
+    }
+
+    // Columns restart after the last newline in the run.
+    size_t last_newline = unread.substr(0, skipped).find_last_of('\n');
+    if (last_newline != absl::string_view::npos) {
+      json_loc_.line += static_cast<size_t>(
+          std::count(unread.data(), unread.data() + last_newline + 1, '\n'));
+    }
+    RETURN_IF_ERROR(Advance(skipped));
+    if (last_newline != absl::string_view::npos) {
+      json_loc_.col = skipped - last_newline - 1;
+    }
+    if (skipped < unread.size()) {
+      return absl::OkStatus();
     }
   }
 }
@@ -416,6 +577,20 @@ absl::StatusOr<LocationWith<MaybeOwnedString>> JsonLexer::ParseUtf8() {
   while (true) {
     RETURN_IF_ERROR(stream_.BufferAtLeast(1).status());
 
+    // Fast path: consume the longest run of bytes that need no escaping or
+    // validation beyond what SkipStringRun() already did.
+    absl::string_view unread = stream_.Unread();
+    size_t run = static_cast<size_t>(
+        SkipStringRun(unread.data(), unread.data() + unread.size()) -
+        unread.data());
+    if (run > 0) {
+      if (!on_heap.empty()) {
+        on_heap.append(unread.data(), run);
+      }
+      RETURN_IF_ERROR(Advance(run));
+      continue;
+    }
+
     char c = stream_.PeekChar();
     RETURN_IF_ERROR(Advance(1));
     switch (c) {
@@ -345,6 +345,40 @@ TEST(LexerTest, Cjk) {
   });
 }
 
+TEST(LexerTest, LongString) {
+  // Long enough to exercise the vectorized scanning paths, with multi-byte
+  // characters and escapes at positions that straddle their block sizes.
+  std::string text = absl::StrCat(std::string(37, 'a'), "施氏食獅史",
+                                  std::string(20, 'b'), "\\n",
+                                  std::string(16, 'c'), "é'");
+  std::string expected = absl::StrCat(std::string(37, 'a'), "施氏食獅史",
+                                      std::string(20, 'b'), "\n",
+                                      std::string(16, 'c'), "é'");
+  Do(absl::StrCat("\"", text, "\""), [&](io::ZeroCopyInputStream* stream) {
+    EXPECT_THAT(Value::Parse(stream),
+                IsOkAndHolds(ValueIs<std::string>(expected)));
+  });
+}
+
+TEST(LexerTest, LongNonUtf8String) {
+  Bad(absl::StrCat("\"", std::string(40, 'a'), "\xe6\x96",
+                   std::string(40, 'a'), "\""));
+  Bad(absl::StrCat("\"", std::string(40, 'a'), "\xff",
+                   std::string(40, 'a'), "\""));
+}
+
+TEST(LexerTest, WhitespaceLocation) {
+  std::string json = absl::StrCat("\n", std::string(20, ' '), "\r\n\t",
+                                  std::string(40, ' '), "*");
+  Do(
+      json,
+      [](io::ZeroCopyInputStream* stream) {
+        EXPECT_THAT(Value::Parse(stream).status().message(),
+                    HasSubstr("3:42"));
+      },
+      false);
+}
+
 TEST(LexerTest, BrokenString) {
   Bad(R"json("broken)json");
   Bad(R"json("broken')json");
@@ -35,8 +35,10 @@
 #include <cmath>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "google/protobuf/type.pb.h"
 #include "google/protobuf/descriptor.h"
@@ -49,6 +51,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
@@ -251,13 +254,59 @@ struct ParseProto2Descriptor : Proto2Descriptor {
 //
 // See MessageTraits for API docs.
 struct ParseProto3Type : Proto3Type {
+  // Fields of the top-level message are written straight to the output.
+  //
+  // Nested messages are length-delimited, so their bytes cannot be written
+  // before their size is known. Instead of serializing every nested message
+  // into a string of its own and copying that into its parent, all open
+  // nested messages share one buffer: each length prefix is reserved at its
+  // widest and recorded as a patch that is filled in when the message closes.
+  // Once the outermost nested message closes, the buffer is copied to the
+  // output in a single pass that writes every prefix in its canonical size.
+  // Peak memory is thus one top-level field's worth of wire format, with no
+  // per-level copies.
   class Msg {
    public:
-    explicit Msg(io::ZeroCopyOutputStream* stream) : stream_(stream) {}
+    explicit Msg(io::ZeroCopyOutputStream* stream)
+        : owned_root_(new Root(stream)),
+          root_(owned_root_.get()),
+          stream_(&root_->output) {}
+    Msg(const Msg&) = delete;
+    Msg& operator=(const Msg&) = delete;
 
    private:
     friend ParseProto3Type;
-    io::CodedOutputStream stream_;
+
+    // A reserved length prefix at `offset` in Root::buffer.
+    struct Patch {
+      size_t offset;
+      uint64_t length;
+    };
+
+    struct Root {
+      explicit Root(io::ZeroCopyOutputStream* stream) : output(stream) {}
+
+      io::CodedOutputStream output;
+      // Present while a nested message is open.
+      std::string buffer;
+      absl::optional<io::StringOutputStream> buffer_stream;
+      absl::optional<io::CodedOutputStream> buffer_output;
+      std::vector<Patch> patches;
+    };
+
+    // A nested message whose content starts at `start` in the root's buffer.
+    Msg(Root* root, size_t start)
+        : root_(root), stream_(&*root->buffer_output), start_(start) {}
+
+    bool nested() const { return owned_root_ == nullptr; }
+
+    std::unique_ptr<Root> owned_root_;
+    Root* root_;
+    io::CodedOutputStream* stream_;
+    size_t start_ = 0;
+    // How many bytes the reserved prefixes of the messages nested in this one
+    // shrink by when written canonically.
+    size_t savings_ = 0;
     absl::flat_hash_set<int32_t> parsed_oneofs_indices_;
     absl::flat_hash_set<int32_t> parsed_fields_;
   };
@@ -294,39 +343,75 @@ struct ParseProto3Type : Proto3Type {
     return WithDynamicType(
         f->parent(), type_url, [&](const Desc& desc) -> absl::Status {
           if (f->proto().kind() == google::protobuf::Field::TYPE_GROUP) {
-            msg.stream_.WriteTag(f->proto().number() << 3 |
+            msg.stream_->WriteTag(f->proto().number() << 3 |
                                  WireFormatLite::WIRETYPE_START_GROUP);
             RETURN_IF_ERROR(body(desc, msg));
-            msg.stream_.WriteTag(f->proto().number() << 3 |
+            msg.stream_->WriteTag(f->proto().number() << 3 |
                                  WireFormatLite::WIRETYPE_END_GROUP);
             return absl::OkStatus();
           }
 
-          std::string out;
-          io::StringOutputStream stream(&out);
-          Msg new_msg(&stream);
+          msg.stream_->WriteTag(f->proto().number() << 3 |
+                                WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+          Msg::Root& root = *msg.root_;
+          size_t patch = 0;
+          if (msg.nested()) {
+            patch = root.patches.size();
+            root.patches.push_back(
+                {static_cast<size_t>(root.buffer_output->ByteCount()), 0});
+            static constexpr char kPlaceholder[kMaxLengthPrefixBytes] = {};
+            root.buffer_output->WriteRaw(kPlaceholder, kMaxLengthPrefixBytes);
+          } else {
+            root.buffer.clear();
+            root.patches.clear();
+            root.buffer_stream.emplace(&root.buffer);
+            root.buffer_output.emplace(&*root.buffer_stream);
+          }
+
+          Msg new_msg(&root,
+                      static_cast<size_t>(root.buffer_output->ByteCount()));
           RETURN_IF_ERROR(body(desc, new_msg));
+          const size_t end =
+              static_cast<size_t>(root.buffer_output->ByteCount());
+          const uint64_t length = end - new_msg.start_ - new_msg.savings_;
+
+          if (msg.nested()) {
+            root.patches[patch].length = length;
+            msg.savings_ += new_msg.savings_ + kMaxLengthPrefixBytes -
+                            io::CodedOutputStream::VarintSize64(length);
+            return absl::OkStatus();
+          }
 
-          new_msg.stream_.Trim();  // Should probably be called "Flush()".
-          absl::string_view written(
-              out.data(), static_cast<size_t>(new_msg.stream_.ByteCount()));
-          SetString(f, msg, written);
+          // The outermost nested message is complete: emit it with every
+          // prefix narrowed to its canonical size.
+          root.buffer_output.reset();
+          root.buffer_stream.reset();
+          msg.stream_->WriteVarint64(length);
+          size_t cursor = 0;
+          for (const Msg::Patch& p : root.patches) {
+            msg.stream_->WriteRaw(root.buffer.data() + cursor,
+                                  static_cast<int>(p.offset - cursor));
+            msg.stream_->WriteVarint64(p.length);
+            cursor = p.offset + kMaxLengthPrefixBytes;
+          }
+          msg.stream_->WriteRaw(root.buffer.data() + cursor,
+                                static_cast<int>(end - cursor));
           return absl::OkStatus();
         });
   }
 
   static void SetFloat(Field f, Msg& msg, float x) {
     RecordAsSeen(f, msg);
-    msg.stream_.WriteTag(f->proto().number() << 3 |
+    msg.stream_->WriteTag(f->proto().number() << 3 |
                          WireFormatLite::WIRETYPE_FIXED32);
-    msg.stream_.WriteLittleEndian32(absl::bit_cast<uint32_t>(x));
+    msg.stream_->WriteLittleEndian32(absl::bit_cast<uint32_t>(x));
   }
 
   static void SetDouble(Field f, Msg& msg, double x) {
     RecordAsSeen(f, msg);
-    msg.stream_.WriteTag(f->proto().number() << 3 |
+    msg.stream_->WriteTag(f->proto().number() << 3 |
                          WireFormatLite::WIRETYPE_FIXED64);
-    msg.stream_.WriteLittleEndian64(absl::bit_cast<uint64_t>(x));
+    msg.stream_->WriteLittleEndian64(absl::bit_cast<uint64_t>(x));
   }
 
   static void SetInt64(Field f, Msg& msg, int64_t x) {
@@ -355,28 +440,32 @@ struct ParseProto3Type : Proto3Type {
 
   static void SetBool(Field f, Msg& msg, bool x) {
     RecordAsSeen(f, msg);
-    msg.stream_.WriteTag(f->proto().number() << 3);
+    msg.stream_->WriteTag(f->proto().number() << 3);
     char b = x ? 0x01 : 0x00;
-    msg.stream_.WriteRaw(&b, 1);
+    msg.stream_->WriteRaw(&b, 1);
   }
 
   static void SetString(Field f, Msg& msg, absl::string_view x) {
     RecordAsSeen(f, msg);
-    msg.stream_.WriteTag(f->proto().number() << 3 |
+    msg.stream_->WriteTag(f->proto().number() << 3 |
                          WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
-    msg.stream_.WriteVarint64(static_cast<uint64_t>(x.size()));
-    msg.stream_.WriteRaw(x.data(), x.size());
+    msg.stream_->WriteVarint64(static_cast<uint64_t>(x.size()));
+    msg.stream_->WriteRaw(x.data(), x.size());
   }
 
   static void SetEnum(Field f, Msg& msg, int32_t x) {
     RecordAsSeen(f, msg);
-    msg.stream_.WriteTag(f->proto().number() << 3);
+    msg.stream_->WriteTag(f->proto().number() << 3);
     // Sign extension is deliberate here.
-    msg.stream_.WriteVarint32(x);
+    msg.stream_->WriteVarint32(x);
   }
 
  private:
   using Kind = google::protobuf::Field::Kind;
+
+  // Room reserved for the length prefix of a nested message.
+  static constexpr int kMaxLengthPrefixBytes = 5;
+
   // Sets a field of *some* integer type, with the given kinds for the possible
   // encodings. This avoids quadruplicating this code in the helpers for the
   // four major integer types.
@@ -392,23 +481,23 @@ struct ParseProto3Type : Proto3Type {
             internal::WireFormatLite::ZigZagEncode64(static_cast<int64_t>(x)));
         ABSL_FALLTHROUGH_INTENDED;
       case varint:
-        msg.stream_.WriteTag(f->proto().number() << 3 |
+        msg.stream_->WriteTag(f->proto().number() << 3 |
                              WireFormatLite::WIRETYPE_VARINT);
         if (sizeof(Int) == 4) {
-          msg.stream_.WriteVarint32(static_cast<uint32_t>(x));
+          msg.stream_->WriteVarint32(static_cast<uint32_t>(x));
         } else {
-          msg.stream_.WriteVarint64(static_cast<uint64_t>(x));
+          msg.stream_->WriteVarint64(static_cast<uint64_t>(x));
         }
         break;
       case fixed: {
         if (sizeof(Int) == 4) {
-          msg.stream_.WriteTag(f->proto().number() << 3 |
+          msg.stream_->WriteTag(f->proto().number() << 3 |
                                WireFormatLite::WIRETYPE_FIXED32);
-          msg.stream_.WriteLittleEndian32(static_cast<uint32_t>(x));
+          msg.stream_->WriteLittleEndian32(static_cast<uint32_t>(x));
         } else {
-          msg.stream_.WriteTag(f->proto().number() << 3 |
+          msg.stream_->WriteTag(f->proto().number() << 3 |
                                WireFormatLite::WIRETYPE_FIXED64);
-          msg.stream_.WriteLittleEndian64(static_cast<uint64_t>(x));
+          msg.stream_->WriteLittleEndian64(static_cast<uint64_t>(x));
         }
         break;
       }
@@ -1283,6 +1283,32 @@ TEST_P(JsonTest, FieldOrder) {
         R"({"boolValue":true,"int64Value":"3","repeatedInt32Value":[2,2]})");
 }
 
+TEST_P(JsonTest, DeeplyNestedLengthPrefixes) {
+  // Nested message lengths straddle the one/two/three byte varint boundaries,
+  // so the back-patched length prefixes must come out in canonical form.
+  protobuf_unittest::NestedTestAllTypes m;
+  protobuf_unittest::NestedTestAllTypes* node = &m;
+  for (int i = 0; i < 64; ++i) {
+    node->mutable_payload()->set_optional_string(std::string(i * 40, 'x'));
+    node = node->mutable_child();
+  }
+  node->mutable_payload()->set_optional_int32(42);
+
+  auto json = ToJson(m);
+  ASSERT_OK(json);
+
+  std::string binary;
+  ASSERT_OK(JsonToBinaryString(
+      resolver_.get(),
+      "type.googleapis.com/protobuf_unittest.NestedTestAllTypes", *json,
+      &binary));
+  EXPECT_EQ(binary, m.SerializeAsString());
+
+  auto parsed = ToProto<protobuf_unittest::NestedTestAllTypes>(*json);
+  ASSERT_OK(parsed);
+  EXPECT_EQ(parsed->SerializeAsString(), m.SerializeAsString());
+}
+
 // JSON values get special treatment when it comes to pre-existing values in
 // their repeated fields, when parsing through their dedicated syntax.
 TEST_P(JsonTest, ClearPreExistingRepeatedInJsonValues) {
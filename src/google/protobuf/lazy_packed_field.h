@@ -5,162 +5,602 @@
 #include "google/protobuf/message_lite.h"
 #include <google/protobuf/arena.h>
 #include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/parse_context.h>
+#include <google/protobuf/stubs/logging.h>
+#include <google/protobuf/wire_format_lite.h>
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
 #include <string>
-#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace google {
 namespace protobuf {
+namespace internal {
+
+/// A ZeroCopyInputStream over the concatenation of `count` buffer slices,
+/// returning each slice as is. The slices must outlive the stream.
+///
+/// The stream shares its slices with lazy fields parsed from it, so nested
+/// lazy fields refer to the same memory instead of copying their bytes.
+class TLazyRefBufferInputStream final : public io::ZeroCopyInputStream {
+public:
+    TLazyRefBufferInputStream(const TLazyRefBuffer* slices, size_t count)
+        : Slices_(slices)
+        , Count_(count)
+    {
+    }
+
+    bool Next(const void** data, int* size) override {
+        for (; Index_ < Count_; ++Index_, Position_ = 0) {
+            int available = SliceSize(Index_) - Position_;
+            if (available > 0) {
+                const TLazyRefBuffer& slice = Slices_[Index_];
+                *data = slice.data.get() + slice.start_offset + Position_;
+                *size = available;
+                Position_ += available;
+                ByteCount_ += available;
+                LastReturnedSize_ = available;
+                return true;
+            }
+        }
+        LastReturnedSize_ = 0;
+        return false;
+    }
+
+    void BackUp(int count) override {
+        GOOGLE_CHECK_LE(count, LastReturnedSize_)
+            << "BackUp() can not exceed the size of the last Next() call.";
+        GOOGLE_CHECK_GE(count, 0);
+        Position_ -= count;
+        ByteCount_ -= count;
+        LastReturnedSize_ = 0;
+    }
+
+    bool Skip(int count) override {
+        GOOGLE_CHECK_GE(count, 0);
+        LastReturnedSize_ = 0;
+        for (; Index_ < Count_; ++Index_, Position_ = 0) {
+            int available = SliceSize(Index_) - Position_;
+            if (count < available) {
+                Position_ += count;
+                ByteCount_ += count;
+                return true;
+            }
+            count -= available;
+            ByteCount_ += available;
+        }
+        return count == 0;
+    }
+
+    int64_t ByteCount() const override { return ByteCount_; }
+
+    io::RefCountBuffer GetSharedBuffer() const override {
+        if (Index_ >= Count_) {
+            return io::RefCountBuffer();
+        }
+        return Slices_[Index_];
+    }
+
+    bool AllowsSharedBuffers() const override { return true; }
+
+private:
+    int SliceSize(size_t index) const {
+        const TLazyRefBuffer& slice = Slices_[index];
+        return static_cast<int>(slice.size - slice.start_offset - slice.end_offset);
+    }
+
+    const TLazyRefBuffer* const Slices_;
+    const size_t Count_;
+
+    size_t Index_ = 0;     // Slice returned by the last Next().
+    int Position_ = 0;     // Bytes of Slices_[Index_] consumed so far.
+    int64_t ByteCount_ = 0;
+    int LastReturnedSize_ = 0;
+};
+
+/// Reads a single field, addressed by a path such as "Files[3].Name", out of
+/// serialized bytes by skipping over the wire format, without parsing the
+/// enclosing message.
+///
+/// Each path component is a field name; repeated fields need an index and
+/// singular fields must not have one. Every component but the last must be a
+/// message field. Values follow parser semantics: the last occurrence of a
+/// singular scalar wins, and occurrences of a singular message merge.
+class TLazyFieldPathReader {
+public:
+    /// The value of the field at the end of the path, as found on the wire.
+    struct Value {
+        const FieldDescriptor* field = nullptr;
+        uint64_t bits = 0;    // Varint and fixed-width values.
+        std::string bytes;    // Length-delimited values.
+    };
+
+    /// Resolves `path` against `descriptor`. Returns false if the path does
+    /// not name a field of the message.
+    bool Init(const Descriptor* descriptor, absl::string_view path) {
+        Path_.clear();
+        for (absl::string_view name : absl::StrSplit(path, '.')) {
+            if (descriptor == nullptr) {
+                return false;  // The previous component is not a message.
+            }
+            int index = -1;
+            size_t bracket = name.find('[');
+            if (bracket != absl::string_view::npos) {
+                if (name.back() != ']' ||
+                    !absl::SimpleAtoi(name.substr(bracket + 1, name.size() - bracket - 2),
+                                      &index) ||
+                    index < 0) {
+                    return false;
+                }
+                name = name.substr(0, bracket);
+            }
+            const FieldDescriptor* field = descriptor->FindFieldByName(std::string(name));
+            if (field == nullptr || field->is_repeated() != (index >= 0) ||
+                field->type() == FieldDescriptor::TYPE_GROUP) {
+                return false;
+            }
+            Path_.push_back({field, index});
+            descriptor = field->message_type();
+        }
+        return !Path_.empty();
+    }
+
+    /// Scans the serialized message in `input` for the resolved path.
+    /// Returns false if the field is absent or the bytes are malformed.
+    bool Read(io::ZeroCopyInputStream* input, Value* value) {
+        io::CodedInputStream coded(input);
+        value->field = Path_.back().field;
+        value->bytes.clear();
+        Seen_.assign(Path_.size(), 0);
+        bool found = false;
+        return Scan(&coded, 0, value, &found) && coded.ConsumedEntireMessage() && found;
+    }
+
+private:
+    using WireFormatLite = internal::WireFormatLite;
+
+    struct Component {
+        const FieldDescriptor* field;
+        int index;  // Element of a repeated field, or -1.
+    };
+
+    bool Scan(io::CodedInputStream* input, size_t depth, Value* value, bool* found) {
+        const Component& component = Path_[depth];
+        const FieldDescriptor* field = component.field;
+        const bool last = depth + 1 == Path_.size();
+        const WireFormatLite::WireType wire_type =
+            WireFormatLite::WireTypeForFieldType(
+                static_cast<WireFormatLite::FieldType>(field->type()));
+        // Elements of a repeated field are counted across all occurrences of
+        // the enclosing message, since those merge.
+        int& seen = Seen_[depth];
+
+        while (uint32_t tag = input->ReadTag()) {
+            if (WireFormatLite::GetTagFieldNumber(tag) != field->number()) {
+                if (!WireFormatLite::SkipField(input, tag)) {
+                    return false;
+                }
+                continue;
+            }
+
+            WireFormatLite::WireType tag_type = WireFormatLite::GetTagWireType(tag);
+            if (tag_type == wire_type) {
+                if (!last) {
+                    uint32_t length;
+                    if (!input->ReadVarint32(&length)) {
+                        return false;
+                    }
+                    if (component.index >= 0 && seen++ != component.index) {
+                        if (!input->Skip(static_cast<int>(length))) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    auto limit = input->PushLimit(static_cast<int>(length));
+                    if (!input->IncrementRecursionDepth() ||
+                        !Scan(input, depth + 1, value, found) ||
+                        !input->ConsumedEntireMessage()) {
+                        return false;
+                    }
+                    input->DecrementRecursionDepth();
+                    input->PopLimit(limit);
+                    continue;
+                }
+                bool selected = component.index < 0 || seen++ == component.index;
+                if (!ReadValue(input, tag_type, selected, value)) {
+                    return false;
+                }
+                *found = *found || selected;
+            } else if (last && field->is_packable() &&
+                       tag_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+                // A packed run of repeated scalars.
+                uint32_t length;
+                if (!input->ReadVarint32(&length)) {
+                    return false;
+                }
+                auto limit = input->PushLimit(static_cast<int>(length));
+                while (input->BytesUntilLimit() > 0) {
+                    bool selected = seen++ == component.index;
+                    if (!ReadValue(input, wire_type, selected, value)) {
+                        return false;
+                    }
+                    *found = *found || selected;
+                }
+                input->PopLimit(limit);
+            } else if (!WireFormatLite::SkipField(input, tag)) {
+                // A wire type mismatch is an unknown field to the parser.
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Reads one value of `wire_type`, storing it only if `selected`.
+    static bool ReadValue(io::CodedInputStream* input,
+                          WireFormatLite::WireType wire_type, bool selected,
+                          Value* value) {
+        switch (wire_type) {
+            case WireFormatLite::WIRETYPE_VARINT: {
+                uint64_t bits;
+                if (!input->ReadVarint64(&bits)) return false;
+                if (selected) value->bits = bits;
+                return true;
+            }
+            case WireFormatLite::WIRETYPE_FIXED32: {
+                uint32_t bits;
+                if (!input->ReadLittleEndian32(&bits)) return false;
+                if (selected) value->bits = bits;
+                return true;
+            }
+            case WireFormatLite::WIRETYPE_FIXED64: {
+                uint64_t bits;
+                if (!input->ReadLittleEndian64(&bits)) return false;
+                if (selected) value->bits = bits;
+                return true;
+            }
+            case WireFormatLite::WIRETYPE_LENGTH_DELIMITED: {
+                uint32_t length;
+                if (!input->ReadVarint32(&length)) return false;
+                if (!selected) return input->Skip(static_cast<int>(length));
+                if (value->field->type() == FieldDescriptor::TYPE_MESSAGE) {
+                    // Occurrences of a singular message merge, which on the
+                    // wire is concatenation.
+                    std::string bytes;
+                    if (!input->ReadString(&bytes, static_cast<int>(length))) return false;
+                    value->bytes += bytes;
+                    return true;
+                }
+                return input->ReadString(&value->bytes, static_cast<int>(length));
+            }
+            default:
+                return false;
+        }
+    }
+
+    std::vector<Component> Path_;
+    std::vector<int> Seen_;
+};
+
+}  // namespace internal
+
+template<class T>
+class RepeatedLazyField;
 
 /// @brief store raw binary data without parsing
 /// and provide Unpack method to deserialize data to Message.
+///
+/// When the field lives on an arena, the raw bytes are copied into arena
+/// memory (or referenced in place if the parser can share its input buffers)
+/// and the unpacked message is created on the same arena on first Unpack(),
+/// so parsing a lazy field does not touch the heap.
+///
+/// The const Unpack() parses the bytes into a read-only value and may be
+/// called concurrently from several threads on a field that is not otherwise
+/// being modified: the bytes are parsed exactly once, and other callers wait
+/// for that parse to finish. The bytes stay authoritative, so serializing
+/// the field writes them verbatim no matter what other readers unpack.
+/// The non-const Unpack() is the mutable access: it drops the bytes and the
+/// value is serialized from then on. All non-const methods still require
+/// exclusive access.
 /// @tparam T Message which will be stored in raw form
 template<class T>
 class TLazyField : public MessageLite {
+/// STRING: the bytes are the single slice BinaryData_.
+/// LIST_BUFFERS: the bytes are the concatenation of BinaryDataList_.
 enum class EBinaryDataType {
     STRING = 0,
     LIST_BUFFERS = 1
 };
 
+/// Values of State_. Only the const Unpack() moves a field from PACKED to
+/// PARSED concurrently; every other transition happens under exclusive
+/// access. Serialization only depends on whether the state is UNPACKED, so
+/// it never changes under a concurrent reader.
+enum EState : int {
+    PACKED = 0,     // Value_ is stale or null; the bytes are authoritative.
+    UNPACKING = 1,  // One thread is parsing the bytes into Value_.
+    PARSED = 2,     // Value_ is published, but the bytes are authoritative.
+    UNPACKED = 3    // Value_ is authoritative; the bytes were dropped.
+};
+
 public:
     TLazyField();
-    TLazyField(google::protobuf::Arena* arena);
+    explicit TLazyField(google::protobuf::Arena* arena);
     TLazyField(const TLazyField<T>& other);
     TLazyField<T>& operator=(const TLazyField<T>& other);
 
-    TLazyField(TLazyField<T>&& other);
-    TLazyField<T>& operator=(TLazyField<T>&& other);
+    TLazyField(TLazyField<T>&& other) noexcept;
+    TLazyField<T>& operator=(TLazyField<T>&& other) noexcept;
     ~TLazyField();
 
     std::string GetTypeName() const override;
     TLazyField<T>* New(Arena* arena) const override;
-    
+
     void Clear() override;
-    
+
     bool IsInitialized() const override;
-    
+
     void CheckTypeAndMergeFrom(const MessageLite& other) override;
-    
+
     size_t ByteSizeLong() const override;
-    
+
     int GetCachedSize() const override;
-    
+
     const Descriptor* GetDescriptor() const;
-    
+
     const Reflection* GetReflection() const;
-    
-    T* Unpack() const;
-    
+
+    /// Returns the value parsed from the bytes, parsing them on first use.
+    const T* Unpack() const;
+
+    /// Returns the value for modification. The bytes are dropped, so later
+    /// serialization re-encodes the value.
+    T* Unpack();
+
     void MergeFrom(const TLazyField<T>& from);
 
+    /// Reads the field at `path` (e.g. "Files[3].Name") straight from the raw
+    /// bytes, without unpacking. See internal::TLazyFieldPathReader for the
+    /// path syntax. Returns false if the path is not valid for T, the field
+    /// is absent, the bytes are malformed, or the field's type does not fit
+    /// `value`: strings, bytes and messages (serialized) read into
+    /// std::string; integers, enums and bools into int64_t or, when not
+    /// signed, uint64_t; floating point into double.
+    bool ReadField(absl::string_view path, std::string* value) const;
+    bool ReadField(absl::string_view path, int64_t* value) const;
+    bool ReadField(absl::string_view path, uint64_t* value) const;
+    bool ReadField(absl::string_view path, double* value) const;
+
     const char* _InternalParse(const char* ptr, internal::ParseContext* ctx) override;
 
+    /// Parses a length-delimited lazy field starting at its length prefix.
+    const char* _InternalParseLengthDelimited(const char* ptr, internal::ParseContext* ctx);
+
     void _InternalParse(std::string&& buff);
 
     void _InternalParse(std::vector<google::protobuf::internal::TLazyRefBuffer> data);
 
+    typedef void InternalArenaConstructable_;
+
 private:
+    template <typename U>
+    friend class Arena::InternalHelper;
+    friend class RepeatedLazyField<T>;
+
     uint8_t* _InternalSerialize(uint8_t* ptr, io::EpsCopyOutputStream* stream) const override;
     size_t GetBinarySize() const;
 
-protected:
+    /// Returns Value_, creating it on the field's arena if needed.
+    T* MutableValue() const;
+
+    bool IsUnpacked() const {
+        return State_.load(std::memory_order_acquire) == UNPACKED;
+    }
+
+    /// Sets State_ from a non-const method, which has exclusive access.
+    void SetState(EState state) {
+        State_.store(state, std::memory_order_relaxed);
+    }
+
+    /// Parses the bytes into Value_ once, racing with other readers.
+    const T* UnpackSlow() const;
+
+    /// Drops the raw bytes, leaving an empty STRING slice.
+    void ResetBinaryData();
+
+    /// Appends `size` uninitialized bytes owned by this field (arena memory
+    /// if it has an arena) and returns them.
+    uint8_t* AddBinaryData(size_t size);
+
+    /// Appends a slice shared with the parser's input or another field.
+    void AppendBinaryData(google::protobuf::internal::TLazyRefBuffer&& buffer);
+
+    /// Appends the raw bytes of `other`, sharing its slices when possible.
+    void AppendBinaryDataFrom(const TLazyField<T>& other);
+
+    /// Returns true if `buffer`, which belongs to a field on `owner`, may be
+    /// referenced from this field without copying: either the slice holds a
+    /// reference on its memory, or its memory lives on this field's arena.
+    bool CanShareBinaryData(const google::protobuf::internal::TLazyRefBuffer& buffer,
+                            const Arena* owner) const;
+
+    void InternalCopyFrom(const TLazyField<T>& other);
+
+    /// Calls `f(data, size)` for each slice of the raw bytes, in order.
+    template <typename F>
+    void ForEachBinarySlice(F f) const;
+
+    /// Returns the slices of the raw bytes and stores their number in
+    /// `count`, for a TLazyRefBufferInputStream which reads them without
+    /// concatenating them.
+    const internal::TLazyRefBuffer* BinarySlices(size_t* count) const;
+
+    /// Finds the field at `path` in the bytes, or in Value_ once unpacked.
+    bool ReadFieldValue(absl::string_view path,
+                        internal::TLazyFieldPathReader::Value* value) const;
 
 private:
     mutable google::protobuf::Arena* arena = nullptr;
     mutable T* Value_ = nullptr;
-    mutable bool IsUnpacked_ = false;
+    mutable std::atomic<int> State_{PACKED};
 
-    EBinaryDataType BinaryDataType_;
+    EBinaryDataType BinaryDataType_ = EBinaryDataType::STRING;
     std::vector<google::protobuf::internal::TLazyRefBuffer> BinaryDataList_;
-    std::shared_ptr<std::string> BinaryData_;
-    mutable absl::optional<size_t> BinarySize_;
+    google::protobuf::internal::TLazyRefBuffer BinaryData_;
+    /// Total size of the raw bytes. Kept current by every mutator rather
+    /// than cached on read, so concurrent readers never write it.
+    size_t BinarySize_ = 0;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////
 
 template<class T>
-TLazyField<T>::TLazyField() 
+TLazyField<T>::TLazyField()
     : arena(nullptr)
-    , IsUnpacked_(true)
 {
-    Value_ = google::protobuf::Arena::CreateMessage<T>(arena);
-    BinaryData_ = std::make_shared<std::string>("");
 }
 
 template<class T>
 TLazyField<T>::TLazyField(google::protobuf::Arena* arena)
-    : arena(arena) 
+    : MessageLite(arena)
+    , arena(arena)
 {
-    IsUnpacked_ = true;
-    Value_ = google::protobuf::Arena::CreateMessage<T>(arena);
-    BinaryData_ = std::make_shared<std::string>("");
 }
 
 
 template<class T>
-TLazyField<T>::TLazyField(const TLazyField<T>& other) {
-    arena = other.arena;
-    if (other.Value_) {
-        Value_ = google::protobuf::Arena::CreateMessage<T>(arena);
-        *Value_ = *other.Value_;
-    }
-    BinaryData_ = other.BinaryData_;
-    BinaryDataList_ = other.BinaryDataList_;
-    BinaryDataType_ = other.BinaryDataType_;
-    BinarySize_ = other.BinarySize_;
-    IsUnpacked_ = other.IsUnpacked_;
+TLazyField<T>::TLazyField(const TLazyField<T>& other)
+    : TLazyField()
+{
+    InternalCopyFrom(other);
 }
 
 template<class T>
-TLazyField<T>::TLazyField(TLazyField<T>&& other) {
-    arena = other.arena;
-    
-    Value_ = other.Value_;
-    other.Value_ = nullptr;
-
-    BinaryData_ = std::move(other.BinaryData_);
-    BinaryDataList_ = std::move(other.BinaryDataList_);
-    BinaryDataType_ = other.BinaryDataType_;
-    BinarySize_ = other.BinarySize_;
-    IsUnpacked_ = other.IsUnpacked_;
+TLazyField<T>::TLazyField(TLazyField<T>&& other) noexcept
+    : TLazyField()
+{
+    *this = std::move(other);
 }
 
 template<class T>
-TLazyField<T>& TLazyField<T>::operator=(TLazyField<T>&& other) {
-    arena = other.arena;
-    
-    Value_ = other.Value_;
-    other.Value_ = nullptr;
+TLazyField<T>& TLazyField<T>::operator=(TLazyField<T>&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (arena != other.arena) {
+        InternalCopyFrom(other);
+        return *this;
+    }
 
+    std::swap(Value_, other.Value_);
     BinaryData_ = std::move(other.BinaryData_);
     BinaryDataList_ = std::move(other.BinaryDataList_);
     BinaryDataType_ = other.BinaryDataType_;
     BinarySize_ = other.BinarySize_;
-    IsUnpacked_ = other.IsUnpacked_;
-    
+    SetState(static_cast<EState>(other.State_.load(std::memory_order_relaxed)));
+    other.Clear();
+
     return *this;
 }
 
 template<class T>
 TLazyField<T>& TLazyField<T>::operator=(const TLazyField<T>& other) {
-    arena = other.arena;
-    if (other.Value_) {
-        Value_ = google::protobuf::Arena::CreateMessage<T>(arena);
-        *Value_ = *other.Value_;
+    if (this != &other) {
+        InternalCopyFrom(other);
     }
-    BinaryData_ = other.BinaryData_;
-    BinaryDataList_ = other.BinaryDataList_;
-    BinaryDataType_ = other.BinaryDataType_;
-    BinarySize_ = other.BinarySize_;
-    IsUnpacked_ = other.IsUnpacked_;
 
     return *this;
 }
 
+template<class T>
+void TLazyField<T>::InternalCopyFrom(const TLazyField<T>& other) {
+    if (other.IsUnpacked()) {
+        *MutableValue() = *other.Value_;
+        ResetBinaryData();
+        SetState(UNPACKED);
+        return;
+    }
+
+    SetState(PACKED);
+    ResetBinaryData();
+    AppendBinaryDataFrom(other);
+}
+
+template<class T>
+void TLazyField<T>::AppendBinaryDataFrom(const TLazyField<T>& other) {
+    bool can_share = true;
+    if (other.BinaryDataType_ == EBinaryDataType::STRING) {
+        can_share = CanShareBinaryData(other.BinaryData_, other.arena);
+    } else {
+        for (const auto& buff : other.BinaryDataList_) {
+            can_share = can_share && CanShareBinaryData(buff, other.arena);
+        }
+    }
+
+    if (can_share) {
+        if (other.BinaryDataType_ == EBinaryDataType::STRING) {
+            if (other.BinaryData_.size > 0) {
+                AppendBinaryData(internal::TLazyRefBuffer(other.BinaryData_));
+            }
+        } else {
+            // Copy the list first: `other` may be this field.
+            std::vector<internal::TLazyRefBuffer> slices = other.BinaryDataList_;
+            for (auto& buff : slices) {
+                AppendBinaryData(std::move(buff));
+            }
+        }
+        return;
+    }
+
+    // The bytes live on another arena or in an input buffer we do not own:
+    // flatten them into storage owned by this field.
+    size_t size = other.GetBinarySize();
+    uint8_t* data = AddBinaryData(size);
+    if (&other == this) {
+        // The new slice is now part of the bytes; stop before it.
+        size_t remaining = size;
+        ForEachBinarySlice([&data, &remaining](const uint8_t* slice, size_t n) {
+            n = std::min(n, remaining);
+            if (n > 0) {
+                std::memcpy(data, slice, n);
+                data += n;
+                remaining -= n;
+            }
+        });
+        return;
+    }
+    other.ForEachBinarySlice([&data](const uint8_t* slice, size_t n) {
+        if (n > 0) {
+            std::memcpy(data, slice, n);
+            data += n;
+        }
+    });
+}
+
+template<class T>
+bool TLazyField<T>::CanShareBinaryData(
+    const google::protobuf::internal::TLazyRefBuffer& buffer,
+    const Arena* owner) const {
+    return buffer.data == nullptr || buffer.data.use_count() > 0 ||
+           (arena != nullptr && arena == owner);
+}
+
 template<class T>
 const char* TLazyField<T>::_InternalParse(const char* ptr, internal::ParseContext* ctx) {
-    if (ctx->IsDerivedFromReleasableBufferStream()) {
+    if (IsUnpacked()) {
+        return Value_->_InternalParse(ptr, ctx);
+    }
+    if (ctx->CanShareBuffers()) {
         _InternalParse(ctx->ReadAllDataAsBuffersArray(&ptr));
     } else {
         _InternalParse(ctx->ReadAllDataAsString(&ptr));
@@ -168,64 +608,312 @@ const char* TLazyField<T>::_InternalParse(const char* ptr, internal::ParseContex
     return ptr;
 }
 
+template<class T>
+const char* TLazyField<T>::_InternalParseLengthDelimited(const char* ptr, internal::ParseContext* ctx) {
+    if (IsUnpacked()) {
+        // Another occurrence of the field merges into the value.
+        return ctx->ParseMessage(Value_, ptr);
+    }
+    // Otherwise the occurrence's bytes are appended: on the wire, merging
+    // is concatenation.
+    int size = internal::ReadSize(&ptr);
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+
+    if (!ctx->CanShareBuffers()) {
+        if (size > ctx->MaximumReadSize(ptr)) {
+            // Not buffered yet: read through a string, which grows as the
+            // bytes actually arrive instead of trusting the length prefix.
+            std::string buff;
+            ptr = ctx->ReadString(ptr, size, &buff);
+            _InternalParse(std::move(buff));
+            return ptr;
+        }
+        uint8_t* data = AddBinaryData(size);
+        if (size > 0) {
+            std::memcpy(data, ptr, size);
+        }
+        return ptr + size;
+    }
+
+    while (size > 0) {
+        if (ctx->Done(&ptr)) {
+            // The message is truncated.
+            return nullptr;
+        }
+        internal::TLazyRefBuffer buffer = ctx->ShareBuffer(ptr, size);
+        int shared = static_cast<int>(buffer.size - buffer.start_offset - buffer.end_offset);
+        ptr += shared;
+        size -= shared;
+        AppendBinaryData(std::move(buffer));
+    }
+    return ptr;
+}
+
+template<class T>
+template<typename F>
+void TLazyField<T>::ForEachBinarySlice(F f) const {
+    if (BinaryDataType_ == EBinaryDataType::STRING) {
+        if (BinaryData_.size > 0) {
+            f(BinaryData_.data.get() + BinaryData_.start_offset,
+              BinaryData_.size - BinaryData_.start_offset - BinaryData_.end_offset);
+        }
+        return;
+    }
+    for (const auto& buff : BinaryDataList_) {
+        f(buff.data.get() + buff.start_offset,
+          buff.size - buff.start_offset - buff.end_offset);
+    }
+}
+
+template<class T>
+bool TLazyField<T>::ReadFieldValue(
+    absl::string_view path, internal::TLazyFieldPathReader::Value* value) const {
+    internal::TLazyFieldPathReader reader;
+    if (!reader.Init(T::GetDescriptor(), path)) {
+        return false;
+    }
+    if (IsUnpacked()) {
+        // Value_ may have been modified since it was parsed.
+        std::string bytes = Value_->SerializeAsString();
+        io::ArrayInputStream input(bytes.data(), static_cast<int>(bytes.size()));
+        return reader.Read(&input, value);
+    }
+    size_t count;
+    const internal::TLazyRefBuffer* slices = BinarySlices(&count);
+    internal::TLazyRefBufferInputStream input(slices, count);
+    return reader.Read(&input, value);
+}
+
+template<class T>
+bool TLazyField<T>::ReadField(absl::string_view path, std::string* value) const {
+    internal::TLazyFieldPathReader::Value found;
+    if (!ReadFieldValue(path, &found)) {
+        return false;
+    }
+    switch (found.field->type()) {
+        case FieldDescriptor::TYPE_STRING:
+        case FieldDescriptor::TYPE_BYTES:
+        case FieldDescriptor::TYPE_MESSAGE:
+            *value = std::move(found.bytes);
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<class T>
+bool TLazyField<T>::ReadField(absl::string_view path, int64_t* value) const {
+    using internal::WireFormatLite;
+    internal::TLazyFieldPathReader::Value found;
+    if (!ReadFieldValue(path, &found)) {
+        return false;
+    }
+    switch (found.field->type()) {
+        case FieldDescriptor::TYPE_INT32:
+        case FieldDescriptor::TYPE_ENUM:
+            *value = static_cast<int32_t>(found.bits);
+            return true;
+        case FieldDescriptor::TYPE_SFIXED32:
+            *value = static_cast<int32_t>(static_cast<uint32_t>(found.bits));
+            return true;
+        case FieldDescriptor::TYPE_INT64:
+        case FieldDescriptor::TYPE_SFIXED64:
+        case FieldDescriptor::TYPE_UINT32:
+        case FieldDescriptor::TYPE_FIXED32:
+            *value = static_cast<int64_t>(found.bits);
+            return true;
+        case FieldDescriptor::TYPE_SINT32:
+            *value = WireFormatLite::ZigZagDecode32(static_cast<uint32_t>(found.bits));
+            return true;
+        case FieldDescriptor::TYPE_SINT64:
+            *value = WireFormatLite::ZigZagDecode64(found.bits);
+            return true;
+        case FieldDescriptor::TYPE_BOOL:
+            *value = found.bits != 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<class T>
+bool TLazyField<T>::ReadField(absl::string_view path, uint64_t* value) const {
+    internal::TLazyFieldPathReader::Value found;
+    if (!ReadFieldValue(path, &found)) {
+        return false;
+    }
+    switch (found.field->type()) {
+        case FieldDescriptor::TYPE_UINT32:
+            *value = static_cast<uint32_t>(found.bits);
+            return true;
+        case FieldDescriptor::TYPE_UINT64:
+        case FieldDescriptor::TYPE_FIXED32:
+        case FieldDescriptor::TYPE_FIXED64:
+            *value = found.bits;
+            return true;
+        case FieldDescriptor::TYPE_BOOL:
+            *value = found.bits != 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<class T>
+bool TLazyField<T>::ReadField(absl::string_view path, double* value) const {
+    using internal::WireFormatLite;
+    internal::TLazyFieldPathReader::Value found;
+    if (!ReadFieldValue(path, &found)) {
+        return false;
+    }
+    switch (found.field->type()) {
+        case FieldDescriptor::TYPE_FLOAT:
+            *value = WireFormatLite::DecodeFloat(static_cast<uint32_t>(found.bits));
+            return true;
+        case FieldDescriptor::TYPE_DOUBLE:
+            *value = WireFormatLite::DecodeDouble(found.bits);
+            return true;
+        default:
+            return false;
+    }
+}
+
+template<class T>
+const internal::TLazyRefBuffer* TLazyField<T>::BinarySlices(size_t* count) const {
+    if (BinaryDataType_ == EBinaryDataType::STRING) {
+        *count = 1;
+        return &BinaryData_;
+    }
+    *count = BinaryDataList_.size();
+    return BinaryDataList_.data();
+}
+
 template<class T>
 uint8_t* TLazyField<T>::_InternalSerialize(uint8_t* ptr, io::EpsCopyOutputStream* stream) const {
-    if (IsUnpacked_) {
+    if (IsUnpacked()) {
         ptr = Value_->_InternalSerialize(ptr, stream);
     } else {
-        if (BinaryDataType_ == EBinaryDataType::STRING) {
-            ptr = stream->WriteRaw(BinaryData_->c_str(), BinaryData_->size(), ptr);
-        } else {
-            for (const auto& buff : BinaryDataList_) {
-                uint8_t* data_start = buff.data.get() + buff.start_offset;
-                uint8_t* data_end = buff.data.get() + buff.size - buff.end_offset;                
-                ptr = stream->WriteRaw(data_start, data_end - data_start, ptr);
-            }
-        }
+        ForEachBinarySlice([&ptr, stream](const uint8_t* data, size_t size) {
+            ptr = stream->WriteRaw(data, size, ptr);
+        });
     }
 
     return ptr;
 }
 
 template<class T>
-T* TLazyField<T>::Unpack() const {
-    if (!IsUnpacked_) {
-        if (BinaryDataType_ == EBinaryDataType::STRING) {
-            Value_->ParseFromString(*BinaryData_);
-        } else {
-            std::string tmp;
-            for (const auto& buff : BinaryDataList_) {
-                tmp += std::string(
-                    buff.data.get() + buff.start_offset,
-                    buff.data.get() + buff.size - buff.end_offset
-                );
-            }
-            Value_->ParseFromString(tmp);
-        }
-        IsUnpacked_ = true;
+T* TLazyField<T>::MutableValue() const {
+    if (Value_ == nullptr) {
+        Value_ = google::protobuf::Arena::CreateMessage<T>(arena);
     }
+    return Value_;
+}
+
+template<class T>
+const T* TLazyField<T>::Unpack() const {
+    if (State_.load(std::memory_order_acquire) >= PARSED) {
+        return Value_;
+    }
+    return UnpackSlow();
+}
 
+template<class T>
+T* TLazyField<T>::Unpack() {
+    if (!IsUnpacked()) {
+        static_cast<const TLazyField<T>&>(*this).Unpack();
+        ResetBinaryData();
+        SetState(UNPACKED);
+    }
     return Value_;
 }
 
+template<class T>
+const T* TLazyField<T>::UnpackSlow() const {
+    int state = PACKED;
+    if (!State_.compare_exchange_strong(state, UNPACKING,
+                                        std::memory_order_acquire)) {
+        // Another reader won the race; the bytes are parsed only once.
+        while (state < PARSED) {
+            std::this_thread::yield();
+            state = State_.load(std::memory_order_acquire);
+        }
+        return Value_;
+    }
+
+    T* value = MutableValue();
+    size_t count;
+    const internal::TLazyRefBuffer* slices = BinarySlices(&count);
+    internal::TLazyRefBufferInputStream input(slices, count);
+    value->ParseFromZeroCopyStream(&input);
+    State_.store(PARSED, std::memory_order_release);
+
+    return value;
+}
+
 template<class T>
 bool TLazyField<T>::IsInitialized() const {
     return true;
 }
 
 template<class T>
-void TLazyField<T>::Clear() {
-    IsUnpacked_ = false;
-    if (Value_) Value_->Clear();
-    BinaryData_ = std::make_shared<std::string>("");
+void TLazyField<T>::ResetBinaryData() {
+    BinaryData_ = internal::TLazyRefBuffer();
     BinaryDataList_.clear();
     BinaryDataType_ = EBinaryDataType::STRING;
-    BinarySize_.reset();
+    BinarySize_ = 0;
+}
+
+template<class T>
+uint8_t* TLazyField<T>::AddBinaryData(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+
+    internal::TLazyRefBuffer buffer;
+    uint8_t* data;
+    if (arena != nullptr) {
+        data = google::protobuf::Arena::CreateArray<uint8_t>(arena, size);
+        // The arena owns the memory, so the slice holds no reference.
+        buffer.data = std::shared_ptr<uint8_t[]>(std::shared_ptr<uint8_t[]>(), data);
+    } else {
+        data = new uint8_t[size];
+        buffer.data.reset(data);
+    }
+    buffer.size = static_cast<int>(size);
+    AppendBinaryData(std::move(buffer));
+    return data;
+}
+
+template<class T>
+void TLazyField<T>::AppendBinaryData(google::protobuf::internal::TLazyRefBuffer&& buffer) {
+    // A value parsed from the old bytes is stale now.
+    SetState(PACKED);
+    BinarySize_ += buffer.size - buffer.start_offset - buffer.end_offset;
+    if (BinaryDataType_ == EBinaryDataType::STRING && BinaryData_.size == 0) {
+        // Most fields are contiguous in the input: keep them inline.
+        BinaryData_ = std::move(buffer);
+        return;
+    }
+    if (BinaryDataType_ == EBinaryDataType::STRING) {
+        BinaryDataList_.push_back(std::move(BinaryData_));
+        BinaryData_ = internal::TLazyRefBuffer();
+        BinaryDataType_ = EBinaryDataType::LIST_BUFFERS;
+    }
+    BinaryDataList_.push_back(std::move(buffer));
+}
+
+template<class T>
+void TLazyField<T>::Clear() {
+    SetState(PACKED);
+    if (Value_) Value_->Clear();
+    ResetBinaryData();
 }
 
 template<class T>
 size_t TLazyField<T>::ByteSizeLong() const {
-    if (!IsUnpacked_) {
+    if (!IsUnpacked()) {
         return GetBinarySize();
     }
     return Value_->ByteSizeLong();
@@ -233,7 +921,7 @@ size_t TLazyField<T>::ByteSizeLong() const {
 
 template<class T>
 int TLazyField<T>::GetCachedSize() const {
-    if (!IsUnpacked_) {
+    if (!IsUnpacked()) {
         return GetBinarySize();
     }
     return Value_->GetCachedSize();
@@ -241,13 +929,29 @@ int TLazyField<T>::GetCachedSize() const {
 
 template<class T>
 void TLazyField<T>::MergeFrom(const TLazyField<T>& from) {
-    if (from.IsUnpacked_) {
-        Unpack()->MergeFrom(*from.Value_);
-    } else {
-        T tmp;
-        tmp.ParseFromString(*from.BinaryData_);
-        Unpack()->MergeFrom(tmp);
+    if (IsUnpacked()) {
+        if (from.IsUnpacked()) {
+            Value_->MergeFrom(*from.Value_);
+        } else {
+            size_t count;
+            const internal::TLazyRefBuffer* slices = from.BinarySlices(&count);
+            internal::TLazyRefBufferInputStream input(slices, count);
+            Value_->MergeFromBoundedZeroCopyStream(
+                &input, static_cast<int>(from.GetBinarySize()));
+        }
+        return;
+    }
+
+    // Stay packed: merging serialized messages is concatenation.
+    if (from.IsUnpacked()) {
+        size_t size = from.Value_->ByteSizeLong();
+        uint8_t* data = AddBinaryData(size);
+        if (size > 0) {
+            from.Value_->SerializeWithCachedSizesToArray(data);
+        }
+        return;
     }
+    AppendBinaryDataFrom(from);
 }
 
 template<class T>
@@ -259,35 +963,46 @@ TLazyField<T>::~TLazyField() {
 
 template<class T>
 void TLazyField<T>::_InternalParse(std::string&& buff) {
-    BinaryData_ = std::make_shared<std::string>(std::move(buff));
-    BinaryDataType_ = EBinaryDataType::STRING;
-    IsUnpacked_ = false;
+    if (IsUnpacked()) {
+        Value_->MergeFromString(buff);
+        return;
+    }
+    if (buff.empty()) {
+        return;
+    }
+    if (arena == nullptr) {
+        // Keep the string's heap buffer alive rather than copying it.
+        auto* owned = new std::string(std::move(buff));
+        std::shared_ptr<std::string> holder(owned);
+        internal::TLazyRefBuffer buffer;
+        buffer.data = std::shared_ptr<uint8_t[]>(
+            holder, reinterpret_cast<uint8_t*>(&(*owned)[0]));
+        buffer.size = static_cast<int>(owned->size());
+        AppendBinaryData(std::move(buffer));
+        return;
+    }
+    std::memcpy(AddBinaryData(buff.size()), buff.data(), buff.size());
 }
 
 template<class T>
 void TLazyField<T>::_InternalParse(std::vector<google::protobuf::internal::TLazyRefBuffer> data) {
-    BinaryDataList_ = std::move(data);
-    BinaryDataType_ = EBinaryDataType::LIST_BUFFERS;
-    IsUnpacked_ = false;
+    if (IsUnpacked()) {
+        int size = 0;
+        for (const auto& buff : data) {
+            size += static_cast<int>(buff.size - buff.start_offset - buff.end_offset);
+        }
+        internal::TLazyRefBufferInputStream input(data.data(), data.size());
+        Value_->MergeFromBoundedZeroCopyStream(&input, size);
+        return;
+    }
+    for (auto& buff : data) {
+        AppendBinaryData(std::move(buff));
+    }
 }
 
 template<class T>
 size_t TLazyField<T>::GetBinarySize() const {
-    if (BinarySize_) {
-        return *BinarySize_;
-    }
-
-    if (BinaryDataType_ == EBinaryDataType::STRING) {
-        BinarySize_ = BinaryData_->size();
-    } else {
-        size_t tmp = 0;
-        for (const auto& buff : BinaryDataList_) {
-            tmp += (buff.size - (buff.start_offset + buff.end_offset));
-        }
-        BinarySize_ = tmp;
-    }
-
-    return *BinarySize_;
+    return BinarySize_;
 }
 
 template<class T>
@@ -307,8 +1022,7 @@ std::string TLazyField<T>::GetTypeName() const {
 
 template<class T>
 TLazyField<T>* TLazyField<T>::New(Arena* arena) const {
-    this->arena = arena;
-    return CreateMaybeMessage<TLazyField<T>>(arena);
+    return google::protobuf::Arena::CreateMessage<TLazyField<T>>(arena);
 }
 
 template<class T>
@@ -318,5 +1032,477 @@ void TLazyField<T>::CheckTypeAndMergeFrom(const MessageLite& other) {
     );
 }
 
+/////////////////////////////////////////////////////////////////////////////////////
+
+/// @brief repeated [lazy_pack = true] field which keeps its elements as
+/// offsets into shared buffers.
+///
+/// Parsing only records where each element's bytes are: elements share the
+/// parser's input buffers when it allows that, and are otherwise packed into
+/// a few large blocks owned by the field. An element gets its TLazyField<T>,
+/// referring to the same bytes, only when it is accessed, so paging through
+/// a huge list costs nothing for the elements that are never touched.
+///
+/// Const access may come from concurrent readers; non-const methods require
+/// exclusive access.
+/// @tparam T Message type of the elements
+template<class T>
+class RepeatedLazyField {
+public:
+    class const_iterator;
+
+    constexpr RepeatedLazyField() = default;
+    explicit RepeatedLazyField(Arena* arena);
+    RepeatedLazyField(const RepeatedLazyField<T>& other);
+    RepeatedLazyField<T>& operator=(const RepeatedLazyField<T>& other);
+    ~RepeatedLazyField();
+
+    int size() const { return Rep_ == nullptr ? 0 : static_cast<int>(Rep_->Elements.size()); }
+    bool empty() const { return size() == 0; }
+
+    /// Returns element `index`, creating its TLazyField on first access.
+    /// The element stays packed until Unpack() is called on it.
+    const TLazyField<T>& Get(int index) const { return *Materialize(index); }
+    const TLazyField<T>& operator[](int index) const { return Get(index); }
+    TLazyField<T>* Mutable(int index) { return Materialize(index); }
+    TLazyField<T>* Add();
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    void Clear();
+
+    /// Appends the elements of `other`, sharing its buffers when possible.
+    void MergeFrom(const RepeatedLazyField<T>& other);
+
+    Arena* GetArena() const { return Arena_; }
+
+    // Generated code support.
+    const TLazyField<T>& InternalCheckedGet(int index, const TLazyField<T>& default_value) const;
+    void InternalSwap(RepeatedLazyField<T>* other);
+    /// Parses one length-delimited element starting at its length prefix.
+    const char* InternalParseElement(const char* ptr, internal::ParseContext* ctx);
+    /// Returns the size of the elements with their length prefixes, but
+    /// without their tags.
+    size_t ElementsByteSizeLong() const;
+    uint8_t* InternalSerialize(int field_number, uint8_t* ptr, io::EpsCopyOutputStream* stream) const;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TLazyField<T>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TLazyField<T>*;
+        using reference = const TLazyField<T>&;
+
+        const_iterator(const RepeatedLazyField<T>* field, int index)
+            : Field_(field)
+            , Index_(index)
+        {
+        }
+
+        reference operator*() const { return Field_->Get(Index_); }
+        pointer operator->() const { return &Field_->Get(Index_); }
+        const_iterator& operator++() {
+            ++Index_;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++Index_;
+            return result;
+        }
+        bool operator==(const const_iterator& other) const { return Index_ == other.Index_; }
+        bool operator!=(const const_iterator& other) const { return Index_ != other.Index_; }
+
+    private:
+        const RepeatedLazyField<T>* Field_;
+        int Index_;
+    };
+
+private:
+    static constexpr uint32_t kNoChunk = ~uint32_t{0};
+    // Bounds for the blocks parsed elements are copied into.
+    static constexpr size_t kMinOwnedBlock = 256;
+    static constexpr size_t kMaxOwnedBlock = 64 * 1024;
+
+    struct Element {
+        Element(uint32_t chunk, size_t offset, int size)
+            : Chunk(chunk)
+            , Size(size)
+            , Offset(offset)
+        {
+        }
+        Element(const Element& other)
+            : Chunk(other.Chunk)
+            , Size(other.Size)
+            , Offset(other.Offset)
+            , Field(other.Field.load(std::memory_order_relaxed))
+        {
+        }
+        Element& operator=(const Element& other) {
+            Chunk = other.Chunk;
+            Size = other.Size;
+            Offset = other.Offset;
+            Field.store(other.Field.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+
+        uint32_t Chunk;  // Index into Chunks, or kNoChunk if empty.
+        int Size;
+        size_t Offset;   // Of the bytes in Chunks[Chunk].data.
+        /// Set once the element is accessed; then it is authoritative. A
+        /// field materialized by a const access refers to the same bytes and
+        /// serializes them until a mutable access, so it never changes the
+        /// element's size under a concurrent serialization.
+        mutable std::atomic<TLazyField<T>*> Field{nullptr};
+    };
+
+    struct Rep {
+        std::vector<internal::TLazyRefBuffer> Chunks;
+        std::vector<Element> Elements;
+        // The block parsed elements are currently copied into.
+        uint32_t OwnedChunk = kNoChunk;
+        size_t OwnedUsed = 0;
+        size_t OwnedCapacity = 0;
+    };
+
+    Rep* MutableRep();
+    TLazyField<T>* Materialize(int index) const;
+    internal::TLazyRefBuffer ElementSlice(const Element& element) const;
+
+    /// Appends an element whose bytes are the whole of `buffer`'s slice.
+    void AddSharedElement(internal::TLazyRefBuffer&& buffer);
+    /// Appends an element of `size` bytes in a block owned by this field and
+    /// returns the bytes to fill in.
+    uint8_t* AddOwnedElement(int size);
+    bool CanShareChunk(const internal::TLazyRefBuffer& chunk, const Arena* owner) const;
+
+    static int SliceSize(const internal::TLazyRefBuffer& buffer) {
+        return static_cast<int>(buffer.size - buffer.start_offset - buffer.end_offset);
+    }
+
+    Rep* Rep_ = nullptr;
+    Arena* Arena_ = nullptr;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+
+// Out-of-class definitions, needed before C++17 when the constants are
+// odr-used (e.g. bound to a reference by std::max).
+template<class T>
+constexpr uint32_t RepeatedLazyField<T>::kNoChunk;
+template<class T>
+constexpr size_t RepeatedLazyField<T>::kMinOwnedBlock;
+template<class T>
+constexpr size_t RepeatedLazyField<T>::kMaxOwnedBlock;
+
+template<class T>
+RepeatedLazyField<T>::RepeatedLazyField(Arena* arena)
+    : Arena_(arena)
+{
+}
+
+template<class T>
+RepeatedLazyField<T>::RepeatedLazyField(const RepeatedLazyField<T>& other)
+    : RepeatedLazyField()
+{
+    MergeFrom(other);
+}
+
+template<class T>
+RepeatedLazyField<T>& RepeatedLazyField<T>::operator=(const RepeatedLazyField<T>& other) {
+    if (this != &other) {
+        Clear();
+        MergeFrom(other);
+    }
+    return *this;
+}
+
+template<class T>
+RepeatedLazyField<T>::~RepeatedLazyField() {
+    if (Arena_ != nullptr) {
+        return;
+    }
+    Clear();
+    delete Rep_;
+}
+
+template<class T>
+typename RepeatedLazyField<T>::Rep* RepeatedLazyField<T>::MutableRep() {
+    if (Rep_ == nullptr) {
+        Rep_ = Arena::Create<Rep>(Arena_);
+    }
+    return Rep_;
+}
+
+template<class T>
+TLazyField<T>* RepeatedLazyField<T>::Add() {
+    TLazyField<T>* field = Arena::CreateMessage<TLazyField<T>>(Arena_);
+    Rep* rep = MutableRep();
+    rep->Elements.emplace_back(kNoChunk, 0, 0);
+    rep->Elements.back().Field.store(field, std::memory_order_relaxed);
+    return field;
+}
+
+template<class T>
+void RepeatedLazyField<T>::Clear() {
+    if (Rep_ == nullptr) {
+        return;
+    }
+    if (Arena_ == nullptr) {
+        for (const Element& element : Rep_->Elements) {
+            delete element.Field.load(std::memory_order_relaxed);
+        }
+    }
+    Rep_->Elements.clear();
+    Rep_->Chunks.clear();
+    Rep_->OwnedChunk = kNoChunk;
+    Rep_->OwnedUsed = 0;
+    Rep_->OwnedCapacity = 0;
+}
+
+template<class T>
+internal::TLazyRefBuffer RepeatedLazyField<T>::ElementSlice(const Element& element) const {
+    internal::TLazyRefBuffer slice = Rep_->Chunks[element.Chunk];
+    slice.start_offset = element.Offset;
+    slice.end_offset = slice.size - element.Offset - element.Size;
+    return slice;
+}
+
+template<class T>
+TLazyField<T>* RepeatedLazyField<T>::Materialize(int index) const {
+    GOOGLE_DCHECK_GE(index, 0);
+    GOOGLE_DCHECK_LT(index, size());
+    const Element& element = Rep_->Elements[index];
+    TLazyField<T>* field = element.Field.load(std::memory_order_acquire);
+    if (field != nullptr) {
+        return field;
+    }
+
+    field = Arena::CreateMessage<TLazyField<T>>(Arena_);
+    if (element.Size > 0) {
+        field->AppendBinaryData(ElementSlice(element));
+    }
+    TLazyField<T>* existing = nullptr;
+    if (!element.Field.compare_exchange_strong(existing, field,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+        // Another reader got there first. On an arena ours just stays unused.
+        if (Arena_ == nullptr) {
+            delete field;
+        }
+        return existing;
+    }
+    return field;
+}
+
+template<class T>
+const TLazyField<T>& RepeatedLazyField<T>::InternalCheckedGet(
+    int index, const TLazyField<T>& default_value) const {
+    if (index < 0 || index >= size()) {
+        return default_value;
+    }
+    return Get(index);
+}
+
+template<class T>
+void RepeatedLazyField<T>::InternalSwap(RepeatedLazyField<T>* other) {
+    GOOGLE_DCHECK(this != other);
+    GOOGLE_DCHECK_EQ(Arena_, other->Arena_);
+    std::swap(Rep_, other->Rep_);
+}
+
+template<class T>
+bool RepeatedLazyField<T>::CanShareChunk(const internal::TLazyRefBuffer& chunk,
+                                         const Arena* owner) const {
+    return chunk.data.use_count() > 0 || (Arena_ != nullptr && Arena_ == owner);
+}
+
+template<class T>
+void RepeatedLazyField<T>::AddSharedElement(internal::TLazyRefBuffer&& buffer) {
+    Rep* rep = MutableRep();
+    size_t offset = buffer.start_offset;
+    int size = SliceSize(buffer);
+    // Consecutive elements usually come from the same input buffer.
+    if (rep->Chunks.empty() || rep->Chunks.size() - 1 == rep->OwnedChunk ||
+        rep->Chunks.back().data != buffer.data ||
+        rep->Chunks.back().size != buffer.size) {
+        buffer.start_offset = 0;
+        buffer.end_offset = 0;
+        rep->Chunks.push_back(std::move(buffer));
+    }
+    rep->Elements.emplace_back(static_cast<uint32_t>(rep->Chunks.size() - 1), offset, size);
+}
+
+template<class T>
+uint8_t* RepeatedLazyField<T>::AddOwnedElement(int size) {
+    Rep* rep = MutableRep();
+    if (size == 0) {
+        rep->Elements.emplace_back(kNoChunk, 0, 0);
+        return nullptr;
+    }
+
+    if (rep->OwnedChunk == kNoChunk ||
+        rep->OwnedUsed + size > rep->OwnedCapacity) {
+        size_t capacity = std::max<size_t>(
+            size, std::min(std::max(2 * rep->OwnedCapacity, kMinOwnedBlock),
+                           kMaxOwnedBlock));
+        internal::TLazyRefBuffer chunk;
+        if (Arena_ != nullptr) {
+            uint8_t* data = Arena::CreateArray<uint8_t>(Arena_, capacity);
+            // The arena owns the memory, so the chunk holds no reference.
+            chunk.data = std::shared_ptr<uint8_t[]>(std::shared_ptr<uint8_t[]>(), data);
+        } else {
+            chunk.data.reset(new uint8_t[capacity]);
+        }
+        chunk.size = static_cast<int>(capacity);
+        rep->OwnedChunk = static_cast<uint32_t>(rep->Chunks.size());
+        rep->OwnedUsed = 0;
+        rep->OwnedCapacity = capacity;
+        rep->Chunks.push_back(std::move(chunk));
+    }
+
+    rep->Elements.emplace_back(rep->OwnedChunk, rep->OwnedUsed, size);
+    uint8_t* data = rep->Chunks[rep->OwnedChunk].data.get() + rep->OwnedUsed;
+    rep->OwnedUsed += size;
+    return data;
+}
+
+template<class T>
+const char* RepeatedLazyField<T>::InternalParseElement(const char* ptr, internal::ParseContext* ctx) {
+    int size = internal::ReadSize(&ptr);
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+
+    if (ctx->CanShareBuffers() && size > 0) {
+        if (ctx->Done(&ptr)) {
+            return nullptr;
+        }
+        internal::TLazyRefBuffer buffer = ctx->ShareBuffer(ptr, size);
+        int shared = SliceSize(buffer);
+        if (shared == size) {
+            AddSharedElement(std::move(buffer));
+            return ptr + size;
+        }
+        // The element straddles input buffers: gather it into owned memory.
+        uint8_t* data = AddOwnedElement(size);
+        while (true) {
+            std::memcpy(data, buffer.data.get() + buffer.start_offset, shared);
+            data += shared;
+            ptr += shared;
+            size -= shared;
+            if (size == 0) {
+                return ptr;
+            }
+            if (ctx->Done(&ptr)) {
+                // The message is truncated.
+                return nullptr;
+            }
+            buffer = ctx->ShareBuffer(ptr, size);
+            shared = SliceSize(buffer);
+        }
+    }
+
+    if (size > ctx->MaximumReadSize(ptr)) {
+        // Not buffered yet: read through a string, which grows as the bytes
+        // actually arrive instead of trusting the length prefix.
+        std::string buff;
+        ptr = ctx->ReadString(ptr, size, &buff);
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+        std::memcpy(AddOwnedElement(size), buff.data(), size);
+        return ptr;
+    }
+    uint8_t* data = AddOwnedElement(size);
+    if (size > 0) {
+        std::memcpy(data, ptr, size);
+    }
+    return ptr + size;
+}
+
+template<class T>
+void RepeatedLazyField<T>::MergeFrom(const RepeatedLazyField<T>& other) {
+    // Read `other` by index and copy what is needed out of it before adding
+    // anything: it may be this field.
+    const int count = other.size();
+    if (count == 0) {
+        return;
+    }
+    std::vector<uint32_t> chunk_map(other.Rep_->Chunks.size(), kNoChunk);
+    for (int i = 0; i < count; i++) {
+        const Element& element = other.Rep_->Elements[i];
+        TLazyField<T>* field = element.Field.load(std::memory_order_acquire);
+        if (field != nullptr) {
+            Add()->MergeFrom(*field);
+            continue;
+        }
+        if (element.Size == 0) {
+            MutableRep()->Elements.emplace_back(kNoChunk, 0, 0);
+            continue;
+        }
+
+        const uint32_t from_chunk = element.Chunk;
+        const size_t offset = element.Offset;
+        const int size = element.Size;
+        if (chunk_map[from_chunk] == kNoChunk) {
+            internal::TLazyRefBuffer chunk = other.Rep_->Chunks[from_chunk];
+            if (CanShareChunk(chunk, other.Arena_)) {
+                Rep* rep = MutableRep();
+                chunk_map[from_chunk] = static_cast<uint32_t>(rep->Chunks.size());
+                rep->Chunks.push_back(std::move(chunk));
+            }
+        }
+        if (chunk_map[from_chunk] != kNoChunk) {
+            MutableRep()->Elements.emplace_back(chunk_map[from_chunk], offset, size);
+            continue;
+        }
+        // The bytes live on another arena or in an input buffer we do not
+        // own. The chunk's memory does not move, even if `other` is this.
+        const uint8_t* data = other.Rep_->Chunks[from_chunk].data.get() + offset;
+        std::memcpy(AddOwnedElement(size), data, size);
+    }
+}
+
+template<class T>
+size_t RepeatedLazyField<T>::ElementsByteSizeLong() const {
+    size_t total = 0;
+    for (int i = 0; i < size(); i++) {
+        const Element& element = Rep_->Elements[i];
+        const TLazyField<T>* field = element.Field.load(std::memory_order_acquire);
+        size_t element_size = field != nullptr ? field->ByteSizeLong() : element.Size;
+        total += internal::WireFormatLite::LengthDelimitedSize(element_size);
+    }
+    return total;
+}
+
+template<class T>
+uint8_t* RepeatedLazyField<T>::InternalSerialize(int field_number, uint8_t* ptr,
+                                                 io::EpsCopyOutputStream* stream) const {
+    using internal::WireFormatLite;
+    for (int i = 0; i < size(); i++) {
+        const Element& element = Rep_->Elements[i];
+        const TLazyField<T>* field = element.Field.load(std::memory_order_acquire);
+        if (field != nullptr) {
+            ptr = WireFormatLite::InternalWriteMessage(
+                field_number, *field, field->GetCachedSize(), ptr, stream);
+            continue;
+        }
+        ptr = stream->EnsureSpace(ptr);
+        ptr = WireFormatLite::WriteTagToArray(
+            field_number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, ptr);
+        ptr = io::CodedOutputStream::WriteVarint32ToArray(
+            static_cast<uint32_t>(element.Size), ptr);
+        if (element.Size > 0) {
+            ptr = stream->WriteRaw(
+                Rep_->Chunks[element.Chunk].data.get() + element.Offset,
+                element.Size, ptr);
+        }
+    }
+    return ptr;
+}
+
 } // namespace protobuf
 } // namespace google
@@ -0,0 +1,313 @@
+#include "google/protobuf/lazy_packed_field_test.pb.h"
+#include "google/protobuf/lazy_packed_field.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+// Every heap allocation of the process is counted, so the parse/unpack
+// benchmarks can report how many allocations they made and how many bytes
+// they allocated.  Lazy fields allocate exactly where they copy input bytes
+// out of the stream, which makes the latter a measure of bytes copied.
+namespace {
+std::atomic<int64_t> allocation_count{0};
+std::atomic<int64_t> allocated_bytes{0};
+}  // namespace
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace google {
+namespace protobuf {
+namespace {
+
+std::string MakeBigProtoBinary(int files) {
+    protobuf_unittest::BigProto big_proto;
+    big_proto.set_start_data(std::string(1024, 's'));
+    big_proto.set_end_data(std::string(1024, 'e'));
+    for (int i = 0; i < files; i++) {
+        auto* file = big_proto.mutable_folder()->add_files();
+        file->set_name("file" + std::to_string(i));
+        file->set_extension("txt");
+        file->set_path("/home/user/folder");
+        file->set_bytesize(i);
+    }
+    return big_proto.SerializeAsString();
+}
+
+// ===================================================================
+// Lazy vs eager parsing.
+//
+// BigProto, BigProtoLazy and LazyFolderLazyWraper share one wire format, so
+// the same payload is parsed eagerly, with a lazy folder, and with a lazy
+// folder of lazy files.  Each benchmark is swept over the payload size (number
+// of files) and the percentage of files read after parsing, and reports:
+//
+//   parse_ns / unpack_ns        time spent in parsing / in reading the files
+//   allocs / alloc_bytes        heap allocations made by both phases
+//
+// Iteration time is the sum of both phases; creating the input stream and
+// destroying the message are not timed.
+
+// The copying inputs (ISTREAM, FD) take their buffers from
+// RefCountBufferPool::Default(), as a lazy parsing application would.
+enum class InputKind {
+    ARRAY,           // ArrayInputStream, copies out of the array
+    ARRAY_ALIASING,  // ArrayInputStream with aliasing, shares the array
+    ISTREAM,         // IstreamInputStream over a std::istringstream
+#ifndef _WIN32
+    FD,              // FileInputStream over a temporary file
+    MMAP,            // MmapInputStream over the same file
+#endif
+};
+
+// A serialized BigProto, also stored in a temporary file for the file inputs.
+struct Payload {
+    std::string bin;
+    std::FILE* file = nullptr;
+};
+
+const Payload& GetPayload(int files) {
+    static auto* payloads = new std::map<int, Payload>;
+    Payload& payload = (*payloads)[files];
+    if (payload.bin.empty()) {
+        payload.bin = MakeBigProtoBinary(files);
+#ifndef _WIN32
+        payload.file = std::tmpfile();
+        std::fwrite(payload.bin.data(), 1, payload.bin.size(), payload.file);
+        std::fflush(payload.file);
+#endif
+    }
+    return payload;
+}
+
+// Reads the name of every file selected by the unpack percentage and returns
+// their total length, so that nothing is optimized away.
+size_t ReadFiles(const protobuf_unittest::BigProto& message, int stride) {
+    size_t total = 0;
+    const auto& files = message.folder().files();
+    for (int i = 0; i < files.size(); i += stride) {
+        total += files.Get(i).name().size();
+    }
+    return total;
+}
+
+size_t ReadFiles(const protobuf_unittest::BigProtoLazy& message, int stride) {
+    size_t total = 0;
+    const auto& files = message.folder().Unpack()->files();
+    for (int i = 0; i < files.size(); i += stride) {
+        total += files.Get(i).name().size();
+    }
+    return total;
+}
+
+size_t ReadFiles(const protobuf_unittest::LazyFolderLazyWraper& message,
+                 int stride) {
+    size_t total = 0;
+    const auto& files = message.folder().Unpack()->files();
+    for (int i = 0; i < files.size(); i += stride) {
+        total += files.Get(i).Unpack()->name().size();
+    }
+    return total;
+}
+
+// The input stream of one iteration. It is created before the timed region,
+// so copying the payload into a std::istringstream or mapping the file is
+// neither timed nor counted.
+class PayloadInput {
+public:
+    PayloadInput(InputKind kind, const Payload& payload) {
+        switch (kind) {
+            case InputKind::ARRAY:
+            case InputKind::ARRAY_ALIASING: {
+                auto* input = new io::ArrayInputStream(
+                    payload.bin.data(), static_cast<int>(payload.bin.size()));
+                input->EnableAliasing(kind == InputKind::ARRAY_ALIASING);
+                input_.reset(input);
+                break;
+            }
+            case InputKind::ISTREAM: {
+                stream_.reset(new std::istringstream(payload.bin));
+                auto* input = new io::IstreamInputStream(stream_.get());
+                input->SetBufferPool(io::RefCountBufferPool::Default());
+                input_.reset(input);
+                break;
+            }
+#ifndef _WIN32
+            case InputKind::FD: {
+                lseek(fileno(payload.file), 0, SEEK_SET);
+                auto* input = new io::FileInputStream(fileno(payload.file));
+                input->SetBufferPool(io::RefCountBufferPool::Default());
+                input_.reset(input);
+                break;
+            }
+            case InputKind::MMAP:
+                lseek(fileno(payload.file), 0, SEEK_SET);
+                input_.reset(new io::MmapInputStream(fileno(payload.file)));
+                break;
+#endif
+        }
+    }
+
+    io::ZeroCopyInputStream* get() { return input_.get(); }
+
+private:
+    std::unique_ptr<std::istringstream> stream_;
+    std::unique_ptr<io::ZeroCopyInputStream> input_;
+};
+
+// Args: number of files, percentage of files read after parsing.
+template <typename Message, InputKind kKind>
+void BM_ParseAndUnpack(benchmark::State& state) {
+    const Payload& payload = GetPayload(static_cast<int>(state.range(0)));
+    const int percent = static_cast<int>(state.range(1));
+    const int stride = percent == 0 ? 0 : 100 / percent;
+
+    using Clock = std::chrono::steady_clock;
+    double parse_ns = 0;
+    double unpack_ns = 0;
+    int64_t allocs = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        Message message;
+        PayloadInput input(kKind, payload);
+        int64_t allocs_before = allocation_count.load(std::memory_order_relaxed);
+        int64_t bytes_before = allocated_bytes.load(std::memory_order_relaxed);
+
+        auto start = Clock::now();
+        if (!message.ParseFromZeroCopyStream(input.get())) {
+            state.SkipWithError("parse failed");
+            break;
+        }
+        auto parsed = Clock::now();
+        if (stride > 0) {
+            benchmark::DoNotOptimize(ReadFiles(message, stride));
+        }
+        auto unpacked = Clock::now();
+
+        allocs += allocation_count.load(std::memory_order_relaxed) - allocs_before;
+        bytes += allocated_bytes.load(std::memory_order_relaxed) - bytes_before;
+        std::chrono::duration<double, std::nano> parse = parsed - start;
+        std::chrono::duration<double, std::nano> unpack = unpacked - parsed;
+        parse_ns += parse.count();
+        unpack_ns += unpack.count();
+        state.SetIterationTime((parse.count() + unpack.count()) * 1e-9);
+    }
+
+    using benchmark::Counter;
+    state.counters["parse_ns"] = Counter(parse_ns, Counter::kAvgIterations);
+    state.counters["unpack_ns"] = Counter(unpack_ns, Counter::kAvgIterations);
+    state.counters["allocs"] = Counter(allocs, Counter::kAvgIterations);
+    state.counters["alloc_bytes"] = Counter(bytes, Counter::kAvgIterations);
+    state.SetBytesProcessed(state.iterations() * payload.bin.size());
+}
+
+void ParseAndUnpackArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"files", "unpack%"});
+    for (int files : {10, 1000, 100000}) {
+        for (int percent : {0, 1, 10, 100}) {
+            b->Args({files, percent});
+        }
+    }
+    b->UseManualTime();
+}
+
+#define BENCHMARK_PARSE_AND_UNPACK(kind)                                     \
+    BENCHMARK_TEMPLATE(BM_ParseAndUnpack, protobuf_unittest::BigProto, kind) \
+        ->Apply(ParseAndUnpackArgs);                                         \
+    BENCHMARK_TEMPLATE(BM_ParseAndUnpack, protobuf_unittest::BigProtoLazy,   \
+                       kind)                                                 \
+        ->Apply(ParseAndUnpackArgs);                                         \
+    BENCHMARK_TEMPLATE(BM_ParseAndUnpack,                                    \
+                       protobuf_unittest::LazyFolderLazyWraper, kind)        \
+        ->Apply(ParseAndUnpackArgs)
+
+BENCHMARK_PARSE_AND_UNPACK(InputKind::ARRAY);
+BENCHMARK_PARSE_AND_UNPACK(InputKind::ARRAY_ALIASING);
+BENCHMARK_PARSE_AND_UNPACK(InputKind::ISTREAM);
+#ifndef _WIN32
+BENCHMARK_PARSE_AND_UNPACK(InputKind::FD);
+BENCHMARK_PARSE_AND_UNPACK(InputKind::MMAP);
+#endif
+
+// ===================================================================
+// Concurrent access.
+
+// Messages shared by all threads of the running contended benchmark. Thread 0
+// fills it before the timed loop; the loop's start barrier publishes it.
+std::vector<protobuf_unittest::BigProtoLazy>* shared_messages = nullptr;
+
+// Every thread unpacks the same field of a fresh message on each iteration,
+// so all but one of them hit the first-access race.
+void BM_ContendedFirstUnpack(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        std::string bin = MakeBigProtoBinary(static_cast<int>(state.range(0)));
+        shared_messages =
+            new std::vector<protobuf_unittest::BigProtoLazy>(state.max_iterations);
+        for (auto& message : *shared_messages) {
+            message.ParseFromString(bin);
+        }
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize((*shared_messages)[i++].folder().Unpack());
+    }
+
+    if (state.thread_index() == 0) {
+        delete shared_messages;
+        shared_messages = nullptr;
+    }
+}
+BENCHMARK(BM_ContendedFirstUnpack)
+    ->Arg(10)
+    ->Arg(1000)
+    ->Iterations(2000)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+// Access after the first Unpack(): a single acquire load.
+void BM_UnpackedAccess(benchmark::State& state) {
+    static protobuf_unittest::BigProtoLazy* message = [] {
+        auto* message = new protobuf_unittest::BigProtoLazy;
+        message->ParseFromString(MakeBigProtoBinary(10));
+        message->folder().Unpack();
+        return message;
+    }();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(message->folder().Unpack());
+    }
+}
+BENCHMARK(BM_UnpackedAccess)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace
+}  // namespace protobuf
+}  // namespace google
+
+BENCHMARK_MAIN();
@@ -1,7 +1,17 @@
 #include "google/protobuf/lazy_packed_field_test.pb.h"
 #include "google/protobuf/lazy_packed_field.h"
+#include "google/protobuf/unittest.pb.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 
 namespace google {
 namespace protobuf {
@@ -189,6 +199,596 @@ TEST(LazyTest, ParseProtoWithLazyFieldFromStream) {
     ASSERT_EQ(folder.files(1).bytesize(), lazy_folder.files(2).Unpack()->bytesize());
 }
 
+protobuf_unittest::Folder MakeFolder() {
+    protobuf_unittest::Folder folder;
+    folder.set_name("my_folder");
+    folder.set_path("/home/andrei");
+
+    for (int i = 0; i < 3; i++) {
+        auto* file = folder.add_files();
+        file->set_name("file" + std::to_string(i));
+        file->set_extension("txt");
+        file->set_path("/home/andrei/my_folder");
+        file->set_bytesize(512 << i);
+    }
+
+    return folder;
+}
+
+void ExpectFolder(const protobuf_unittest::FolderLazy& lazy_folder,
+                  const protobuf_unittest::Folder& folder) {
+    ASSERT_EQ(lazy_folder.files().size(), folder.files().size());
+    for (int i = 0; i < folder.files().size(); i++) {
+        ASSERT_EQ(lazy_folder.files(i).Unpack()->SerializeAsString(),
+                  folder.files(i).SerializeAsString());
+    }
+    ASSERT_EQ(lazy_folder.SerializeAsString(), folder.SerializeAsString());
+}
+
+// Parsing with aliasing enabled lets lazy fields refer to the flat input
+// buffer directly, which the caller keeps alive.
+TEST(LazyTest, ParseProtoWithLazyFieldWithAliasing) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    std::string expected_bin = folder.SerializeAsString();
+
+    protobuf_unittest::FolderLazy lazy_folder;
+    ASSERT_TRUE(lazy_folder.ParseFrom<MessageLite::kParseWithAliasing>(
+        absl::string_view(expected_bin)));
+    ExpectFolder(lazy_folder, folder);
+}
+
+// Like ParseProtoWithLazyFieldWithAliasing but from an aliasing
+// ArrayInputStream, with block sizes that split fields across chunks.
+TEST(LazyTest, ParseProtoWithLazyFieldFromAliasingArrayStream) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    std::string expected_bin = folder.SerializeAsString();
+
+    for (int block_size : {-1, 1, 7, 20, 64}) {
+        SCOPED_TRACE(block_size);
+        io::ArrayInputStream input(expected_bin.data(), expected_bin.size(),
+                                   block_size);
+        input.EnableAliasing(true);
+        ASSERT_TRUE(input.AllowsSharedBuffers());
+
+        protobuf_unittest::FolderLazy lazy_folder;
+        ASSERT_TRUE(lazy_folder.ParseFromZeroCopyStream(&input));
+        ExpectFolder(lazy_folder, folder);
+    }
+}
+
+TEST(LazyTest, ParseTruncatedProtoWithLazyField) {
+    std::string bin = MakeFolder().SerializeAsString();
+    bin.resize(bin.size() / 2);
+
+    protobuf_unittest::FolderLazy lazy_folder;
+    EXPECT_FALSE(lazy_folder.ParseFrom<MessageLite::kParseWithAliasing>(
+        absl::string_view(bin)));
+
+    std::stringstream ss(bin);
+    EXPECT_FALSE(lazy_folder.ParseFromIstream(&ss));
+}
+
+internal::TLazyRefBuffer MakeSlice(absl::string_view data, size_t start,
+                                   size_t end) {
+    internal::TLazyRefBuffer slice;
+    slice.data.reset(new uint8_t[data.size()]);
+    std::memcpy(slice.data.get(), data.data(), data.size());
+    slice.size = static_cast<int>(data.size());
+    slice.start_offset = start;
+    slice.end_offset = end;
+    return slice;
+}
+
+TEST(LazyTest, RefBufferInputStream) {
+    std::vector<internal::TLazyRefBuffer> slices;
+    slices.push_back(MakeSlice("xxabcde", 2, 0));
+    slices.push_back(MakeSlice("", 0, 0));
+    slices.push_back(MakeSlice("fghyy", 0, 2));
+    internal::TLazyRefBufferInputStream input(slices.data(), slices.size());
+
+    const void* data;
+    int size;
+    ASSERT_TRUE(input.Next(&data, &size));
+    EXPECT_EQ(absl::string_view(static_cast<const char*>(data), size), "abcde");
+    EXPECT_EQ(input.GetSharedBuffer().data, slices[0].data);
+    input.BackUp(2);
+    EXPECT_EQ(input.ByteCount(), 3);
+    ASSERT_TRUE(input.Skip(3));
+    ASSERT_TRUE(input.Next(&data, &size));
+    EXPECT_EQ(absl::string_view(static_cast<const char*>(data), size), "gh");
+    EXPECT_EQ(input.GetSharedBuffer().data, slices[2].data);
+    EXPECT_EQ(input.ByteCount(), 8);
+    EXPECT_FALSE(input.Next(&data, &size));
+    EXPECT_FALSE(input.Skip(1));
+}
+
+// On an arena the raw bytes and the unpacked message are arena-allocated.
+TEST(LazyTest, ParseProtoWithLazyFieldOnArena) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    std::string expected_bin = folder.SerializeAsString();
+
+    Arena arena;
+    auto* lazy_folder =
+        Arena::CreateMessage<protobuf_unittest::FolderLazy>(&arena);
+    ASSERT_TRUE(lazy_folder->ParseFromString(expected_bin));
+    for (const auto& file : lazy_folder->files()) {
+        EXPECT_EQ(file.GetArena(), &arena);
+        EXPECT_EQ(file.Unpack()->GetArena(), &arena);
+    }
+    ExpectFolder(*lazy_folder, folder);
+
+    std::stringstream ss(expected_bin);
+    ASSERT_TRUE(lazy_folder->ParseFromIstream(&ss));
+    ExpectFolder(*lazy_folder, folder);
+}
+
+// Copying a packed field off an arena must not keep pointers into it.
+TEST(LazyTest, CopyLazyFieldFromArena) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    std::string expected_bin = folder.SerializeAsString();
+
+    protobuf_unittest::FolderLazy heap_folder;
+    {
+        Arena arena;
+        auto* lazy_folder =
+            Arena::CreateMessage<protobuf_unittest::FolderLazy>(&arena);
+        ASSERT_TRUE(lazy_folder->ParseFromString(expected_bin));
+        heap_folder = *lazy_folder;
+
+        auto* arena_folder =
+            Arena::CreateMessage<protobuf_unittest::FolderLazy>(&arena);
+        *arena_folder = *lazy_folder;
+        ExpectFolder(*arena_folder, folder);
+    }
+    ExpectFolder(heap_folder, folder);
+}
+
+TEST(LazyTest, ReadFieldWithoutUnpack) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    folder.set_bytesize(4096);
+    protobuf_unittest::BigProto big_proto;
+    *big_proto.mutable_folder() = folder;
+    std::string bin = big_proto.SerializeAsString();
+
+    for (int block_size : {-1, 7}) {
+        SCOPED_TRACE(block_size);
+        io::ArrayInputStream input(bin.data(), bin.size(), block_size);
+        input.EnableAliasing(true);
+        protobuf_unittest::BigProtoLazy lazy;
+        ASSERT_TRUE(lazy.ParseFromZeroCopyStream(&input));
+        const auto& lazy_folder = lazy.folder();
+
+        std::string name;
+        EXPECT_TRUE(lazy_folder.ReadField("Name", &name));
+        EXPECT_EQ(name, "my_folder");
+        EXPECT_TRUE(lazy_folder.ReadField("Files[2].Name", &name));
+        EXPECT_EQ(name, "file2");
+
+        int64_t signed_size;
+        uint64_t unsigned_size;
+        EXPECT_TRUE(lazy_folder.ReadField("ByteSize", &unsigned_size));
+        EXPECT_EQ(unsigned_size, 4096);
+        EXPECT_TRUE(lazy_folder.ReadField("ByteSize", &signed_size));
+        EXPECT_EQ(signed_size, 4096);
+        EXPECT_TRUE(lazy_folder.ReadField("Files[1].ByteSize", &signed_size));
+        EXPECT_EQ(signed_size, 1024);
+
+        std::string file;
+        EXPECT_TRUE(lazy_folder.ReadField("Files[0]", &file));
+        EXPECT_EQ(file, folder.files(0).SerializeAsString());
+
+        // Absent fields, invalid paths and mismatched types.
+        EXPECT_FALSE(lazy_folder.ReadField("Files[3].Name", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("Files.Name", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("Name[0]", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("Name.Path", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("NoSuchField", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("Files[x].Name", &name));
+        EXPECT_FALSE(lazy_folder.ReadField("Name", &signed_size));
+        EXPECT_FALSE(lazy_folder.ReadField("Files[1].ByteSize", &unsigned_size));
+
+        // Once unpacked, reads reflect changes to the value.
+        lazy.mutable_folder()->Unpack()->mutable_files(2)->set_name("renamed");
+        EXPECT_TRUE(lazy_folder.ReadField("Files[2].Name", &name));
+        EXPECT_EQ(name, "renamed");
+    }
+}
+
+// Occurrences of a singular message merge: repeated elements and scalars
+// are read across all of them.
+TEST(LazyTest, ReadFieldFromMergedOccurrences) {
+    protobuf_unittest::BigProto first;
+    first.mutable_folder()->set_name("first");
+    first.mutable_folder()->add_files()->set_name("a");
+    protobuf_unittest::BigProto second;
+    second.mutable_folder()->add_files()->set_name("b");
+    std::string bin = first.SerializeAsString() + second.SerializeAsString();
+
+    internal::TLazyFieldPathReader::Value value;
+    internal::TLazyFieldPathReader reader;
+    ASSERT_TRUE(reader.Init(protobuf_unittest::BigProto::descriptor(),
+                            "Folder.Files[1].Name"));
+    io::ArrayInputStream files_input(bin.data(), bin.size());
+    EXPECT_TRUE(reader.Read(&files_input, &value));
+    EXPECT_EQ(value.bytes, "b");
+
+    ASSERT_TRUE(reader.Init(protobuf_unittest::BigProto::descriptor(),
+                            "Folder.Name"));
+    io::ArrayInputStream name_input(bin.data(), bin.size());
+    EXPECT_TRUE(reader.Read(&name_input, &value));
+    EXPECT_EQ(value.bytes, "first");
+
+    ASSERT_TRUE(reader.Init(protobuf_unittest::BigProto::descriptor(),
+                            "Folder"));
+    io::ArrayInputStream folder_input(bin.data(), bin.size());
+    EXPECT_TRUE(reader.Read(&folder_input, &value));
+    protobuf_unittest::Folder merged = first.folder();
+    merged.MergeFrom(second.folder());
+    protobuf_unittest::Folder read;
+    ASSERT_TRUE(read.ParseFromString(value.bytes));
+    EXPECT_EQ(read.SerializeAsString(), merged.SerializeAsString());
+}
+
+// Packed and unpacked runs of a repeated scalar are indexed together.
+TEST(LazyTest, ReadPackedFieldElement) {
+    protobuf_unittest::TestPackedTypes packed;
+    packed.add_packed_sint32(-1);
+    packed.add_packed_sint32(-2);
+    packed.add_packed_double(0.5);
+    protobuf_unittest::TestUnpackedTypes unpacked;
+    unpacked.add_unpacked_sint32(-3);
+    // Field numbers match, so the concatenation parses as TestPackedTypes.
+    std::string bin = packed.SerializeAsString() + unpacked.SerializeAsString();
+
+    internal::TLazyFieldPathReader::Value value;
+    internal::TLazyFieldPathReader reader;
+    ASSERT_TRUE(reader.Init(protobuf_unittest::TestPackedTypes::descriptor(),
+                            "packed_sint32[2]"));
+    io::ArrayInputStream sint_input(bin.data(), bin.size());
+    EXPECT_TRUE(reader.Read(&sint_input, &value));
+    EXPECT_EQ(internal::WireFormatLite::ZigZagDecode32(value.bits), -3);
+
+    ASSERT_TRUE(reader.Init(protobuf_unittest::TestPackedTypes::descriptor(),
+                            "packed_double[0]"));
+    io::ArrayInputStream double_input(bin.data(), bin.size());
+    EXPECT_TRUE(reader.Read(&double_input, &value));
+    EXPECT_EQ(internal::WireFormatLite::DecodeDouble(value.bits), 0.5);
+}
+
+// Repeated occurrences of a singular lazy field merge while parsing.
+TEST(LazyTest, ParseMergesOccurrences) {
+    protobuf_unittest::BigProto first;
+    first.mutable_folder()->set_name("first");
+    first.mutable_folder()->add_files()->set_name("a");
+    protobuf_unittest::BigProto second;
+    second.mutable_folder()->add_files()->set_name("b");
+    std::string bin = first.SerializeAsString() + second.SerializeAsString();
+
+    protobuf_unittest::BigProto expected;
+    ASSERT_TRUE(expected.ParseFromString(bin));
+
+    protobuf_unittest::BigProtoLazy lazy;
+    ASSERT_TRUE(lazy.ParseFromString(bin));
+    EXPECT_EQ(lazy.folder().Unpack()->SerializeAsString(),
+              expected.folder().SerializeAsString());
+
+    std::stringstream ss(bin);
+    ASSERT_TRUE(lazy.ParseFromIstream(&ss));
+    EXPECT_EQ(lazy.folder().Unpack()->SerializeAsString(),
+              expected.folder().SerializeAsString());
+
+    // Once unpacked, a later occurrence merges into the value.
+    protobuf_unittest::LazyFolderLazyWraper wrapper;
+    ASSERT_TRUE(wrapper.ParseFromString(first.SerializeAsString()));
+    wrapper.mutable_folder()->Unpack();
+    ASSERT_TRUE(wrapper.MergeFromString(second.SerializeAsString()));
+    ASSERT_EQ(wrapper.folder().Unpack()->files_size(), 2);
+    EXPECT_EQ(wrapper.folder().Unpack()->name(), "first");
+    EXPECT_EQ(wrapper.folder().Unpack()->files(1).Unpack()->name(), "b");
+}
+
+// Merging packed fields concatenates their bytes, which serialize verbatim.
+TEST(LazyTest, MergePackedFields) {
+    protobuf_unittest::BigProto first;
+    first.mutable_folder()->set_name("first");
+    first.mutable_folder()->add_files()->set_name("a");
+    protobuf_unittest::BigProto second;
+    *second.mutable_folder() = MakeFolder();
+
+    protobuf_unittest::BigProto expected = first;
+    expected.MergeFrom(second);
+
+    for (bool unpack_to : {false, true}) {
+        for (bool unpack_from : {false, true}) {
+            SCOPED_TRACE(absl::StrCat(unpack_to, " ", unpack_from));
+            protobuf_unittest::BigProtoLazy to;
+            protobuf_unittest::BigProtoLazy from;
+            ASSERT_TRUE(to.ParseFromString(first.SerializeAsString()));
+            ASSERT_TRUE(from.ParseFromString(second.SerializeAsString()));
+            if (unpack_to) to.mutable_folder()->Unpack();
+            if (unpack_from) from.mutable_folder()->Unpack();
+
+            to.MergeFrom(from);
+            if (!unpack_to && !unpack_from) {
+                EXPECT_EQ(to.folder().SerializeAsString(),
+                          first.folder().SerializeAsString() +
+                              second.folder().SerializeAsString());
+            }
+            EXPECT_EQ(to.folder().Unpack()->SerializeAsString(),
+                      expected.folder().SerializeAsString());
+        }
+    }
+
+    // Merging a packed field into itself doubles it.
+    protobuf_unittest::BigProtoLazy self;
+    ASSERT_TRUE(self.ParseFromString(first.SerializeAsString()));
+    self.mutable_folder()->MergeFrom(self.folder());
+    EXPECT_EQ(self.folder().Unpack()->files_size(), 2);
+}
+
+// Repeated lazy fields merge element-wise, sharing their buffers.
+TEST(LazyTest, MergeRepeatedLazyFields) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    std::string bin = folder.SerializeAsString();
+
+    Arena arena;
+    auto* on_arena = Arena::CreateMessage<protobuf_unittest::FolderLazy>(&arena);
+    ASSERT_TRUE(on_arena->ParseFromString(bin));
+    protobuf_unittest::FolderLazy on_heap;
+    ASSERT_TRUE(on_heap.ParseFromString(bin));
+
+    on_arena->MergeFrom(on_heap);
+    on_heap.MergeFrom(*on_arena);
+    protobuf_unittest::Folder expected = folder;
+    expected.MergeFrom(folder);
+    ExpectFolder(*on_arena, expected);
+    protobuf_unittest::Folder heap_expected = folder;
+    heap_expected.MergeFrom(expected);
+    ExpectFolder(on_heap, heap_expected);
+}
+
+protobuf_unittest::Folder MakeBigFolder(int files) {
+    protobuf_unittest::Folder folder;
+    folder.set_name("big_folder");
+    for (int i = 0; i < files; i++) {
+        auto* file = folder.add_files();
+        file->set_name("file" + std::to_string(i));
+        file->set_bytesize(i);
+    }
+    return folder;
+}
+
+// Repeated lazy elements are offsets into shared buffers; any one of them can
+// be read or changed, and the rest serialize verbatim.
+TEST(LazyTest, RepeatedLazyFieldRandomAccess) {
+    protobuf_unittest::Folder folder = MakeBigFolder(1000);
+    std::string bin = folder.SerializeAsString();
+
+    for (int block_size : {-1, 1, 7, 4096}) {
+        SCOPED_TRACE(block_size);
+        for (bool aliasing : {false, true}) {
+            io::ArrayInputStream input(bin.data(), bin.size(), block_size);
+            input.EnableAliasing(aliasing);
+            protobuf_unittest::FolderLazy lazy_folder;
+            ASSERT_TRUE(lazy_folder.ParseFromZeroCopyStream(&input));
+
+            ASSERT_EQ(lazy_folder.files_size(), 1000);
+            EXPECT_EQ(lazy_folder.files(777).Unpack()->name(), "file777");
+            EXPECT_EQ(lazy_folder.files(3).ByteSizeLong(),
+                      folder.files(3).ByteSizeLong());
+            EXPECT_EQ(lazy_folder.SerializeAsString(), bin);
+
+            lazy_folder.mutable_files(5)->Unpack()->set_name("changed");
+            protobuf_unittest::Folder expected = folder;
+            expected.mutable_files(5)->set_name("changed");
+            EXPECT_EQ(lazy_folder.SerializeAsString(), expected.SerializeAsString());
+
+            int count = 0;
+            for (const auto& file : lazy_folder.files()) {
+                EXPECT_EQ(file.Unpack()->bytesize(), count);
+                count++;
+            }
+            EXPECT_EQ(count, 1000);
+        }
+    }
+
+    std::stringstream ss(bin);
+    protobuf_unittest::FolderLazy lazy_folder;
+    ASSERT_TRUE(lazy_folder.ParseFromIstream(&ss));
+    EXPECT_EQ(lazy_folder.files(999).Unpack()->name(), "file999");
+    EXPECT_EQ(lazy_folder.SerializeAsString(), bin);
+}
+
+TEST(LazyTest, RepeatedLazyFieldAddAndCopy) {
+    protobuf_unittest::Folder folder = MakeBigFolder(10);
+
+    Arena arena;
+    auto* on_arena = Arena::CreateMessage<protobuf_unittest::FolderLazy>(&arena);
+    ASSERT_TRUE(on_arena->ParseFromString(folder.SerializeAsString()));
+    auto* added = on_arena->add_files();
+    EXPECT_EQ(added->GetArena(), &arena);
+    added->Unpack()->set_name("added");
+    *folder.add_files()->mutable_name() = "added";
+
+    // Copying off the arena must not refer to arena memory.
+    protobuf_unittest::FolderLazy on_heap(*on_arena);
+    on_arena->clear_files();
+    EXPECT_EQ(on_arena->files_size(), 0);
+    ExpectFolder(on_heap, folder);
+
+    protobuf_unittest::FolderLazy empty;
+    on_heap.Swap(&empty);
+    EXPECT_EQ(on_heap.files_size(), 0);
+    ExpectFolder(empty, folder);
+}
+
+// Concurrent readers of one element all get the same TLazyField.
+TEST(LazyTest, RepeatedLazyFieldConcurrentGet) {
+    std::string bin = MakeBigFolder(100).SerializeAsString();
+    const int kThreads = 8;
+    for (int round = 0; round < 20; round++) {
+        protobuf_unittest::FolderLazy lazy_folder;
+        ASSERT_TRUE(lazy_folder.ParseFromString(bin));
+        std::vector<const TLazyField<protobuf_unittest::File>*> seen(kThreads);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.emplace_back([&lazy_folder, &seen, i] {
+                seen[i] = &lazy_folder.files(i % 2);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (int i = 0; i < kThreads; i++) {
+            EXPECT_EQ(seen[i], &lazy_folder.files(i % 2));
+        }
+    }
+}
+
+// Readers racing on the first Unpack() must all see the same fully parsed
+// value, and serializing while another thread unpacks must stay consistent.
+TEST(LazyTest, ConcurrentUnpack) {
+    protobuf_unittest::Folder folder = MakeFolder();
+    protobuf_unittest::BigProto big_proto;
+    *big_proto.mutable_folder() = folder;
+    std::string expected_bin = big_proto.SerializeAsString();
+
+    const int kThreads = 8;
+    for (int round = 0; round < 20; round++) {
+        protobuf_unittest::BigProtoLazy lazy;
+        ASSERT_TRUE(lazy.ParseFromString(expected_bin));
+
+        std::vector<const protobuf_unittest::Folder*> seen(kThreads);
+        std::vector<std::string> serialized(kThreads);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.emplace_back([&lazy, &seen, &serialized, i] {
+                if (i % 2 == 0) {
+                    seen[i] = lazy.folder().Unpack();
+                } else {
+                    serialized[i] = lazy.SerializeAsString();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int i = 0; i < kThreads; i++) {
+            if (i % 2 == 0) {
+                EXPECT_EQ(seen[i], seen[0]);
+                EXPECT_EQ(seen[i]->SerializeAsString(),
+                          folder.SerializeAsString());
+            } else {
+                EXPECT_EQ(serialized[i], expected_bin);
+            }
+        }
+    }
+}
+
+// The bytes of merged occurrences and non-canonical varints re-encode to a
+// different size: a reader unpacking the field must not switch a concurrent
+// serialization over to the value.
+TEST(LazyTest, ConcurrentUnpackKeepsBytes) {
+    protobuf_unittest::BigProto first;
+    first.mutable_folder()->set_name("first");
+    first.mutable_folder()->add_files()->set_name("a");
+    protobuf_unittest::BigProto second;
+    second.mutable_folder()->set_name("second");
+    // Tag of Folder.ByteSize followed by 7 encoded as two bytes.
+    std::string folder_bin = first.folder().SerializeAsString() +
+                             second.folder().SerializeAsString() +
+                             std::string("\x20\x87\x00", 3);
+    std::string bin = "\x12" + std::string(1, static_cast<char>(folder_bin.size())) +
+                      folder_bin;
+    ASSERT_LT(folder_bin.size(), 128);
+
+    const int kThreads = 8;
+    for (int round = 0; round < 20; round++) {
+        protobuf_unittest::BigProtoLazy lazy;
+        ASSERT_TRUE(lazy.ParseFromString(bin));
+
+        std::vector<std::string> serialized(kThreads);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.emplace_back([&lazy, &serialized, i] {
+                if (i % 2 == 0) {
+                    lazy.folder().Unpack();
+                } else {
+                    serialized[i] = lazy.SerializeAsString();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int i = 1; i < kThreads; i += 2) {
+            EXPECT_EQ(serialized[i], bin);
+        }
+        EXPECT_EQ(lazy.folder().Unpack()->name(), "second");
+        EXPECT_EQ(lazy.folder().Unpack()->bytesize(), 7);
+        EXPECT_EQ(lazy.SerializeAsString(), bin);
+    }
+
+    // Modifying the value drops the bytes.
+    protobuf_unittest::BigProtoLazy lazy;
+    ASSERT_TRUE(lazy.ParseFromString(bin));
+    lazy.mutable_folder()->Unpack()->set_name("third");
+    protobuf_unittest::BigProto parsed;
+    ASSERT_TRUE(parsed.ParseFromString(lazy.SerializeAsString()));
+    EXPECT_EQ(parsed.folder().name(), "third");
+    EXPECT_EQ(parsed.folder().files_size(), 1);
+    EXPECT_EQ(lazy.ByteSizeLong(), lazy.SerializeAsString().size());
+}
+
+// Same for elements of a repeated lazy field, which readers materialize and
+// unpack while the enclosing message is being serialized.
+TEST(LazyTest, RepeatedConcurrentUnpackKeepsBytes) {
+    protobuf_unittest::File first;
+    first.set_name("first");
+    protobuf_unittest::File second;
+    second.set_name("second");
+    // Tag of File.ByteSize followed by 7 encoded as two bytes.
+    std::string file_bin = first.SerializeAsString() + second.SerializeAsString() +
+                           std::string("\x20\x87\x00", 3);
+    ASSERT_LT(file_bin.size(), 128);
+    std::string bin;
+    const int kFiles = 16;
+    for (int i = 0; i < kFiles; i++) {
+        bin += "\x12" + std::string(1, static_cast<char>(file_bin.size())) + file_bin;
+    }
+
+    const int kThreads = 8;
+    for (int round = 0; round < 20; round++) {
+        protobuf_unittest::FolderLazy lazy_folder;
+        ASSERT_TRUE(lazy_folder.ParseFromString(bin));
+
+        std::vector<std::string> serialized(kThreads);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kThreads; i++) {
+            threads.emplace_back([&lazy_folder, &serialized, i] {
+                if (i % 2 == 0) {
+                    for (int j = 0; j < kFiles; j++) {
+                        lazy_folder.files(j).Unpack();
+                    }
+                } else {
+                    serialized[i] = lazy_folder.SerializeAsString();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int i = 1; i < kThreads; i += 2) {
+            EXPECT_EQ(serialized[i], bin);
+        }
+        EXPECT_EQ(lazy_folder.files(3).Unpack()->name(), "second");
+        EXPECT_EQ(lazy_folder.SerializeAsString(), bin);
+    }
+}
+
 TEST(LazyTest, TestLazyChangeUnpack) {
     protobuf_unittest::Folder folder;
     protobuf_unittest::FolderLazy lazy_folder;
@@ -224,7 +824,7 @@ TEST(LazyTest, TestLazyChangeUnpack) {
     ASSERT_TRUE(lazy_folder.ParseFromString(folder.SerializeAsString()));
 
     for (size_t i = 0; i < lazy_folder.files().size(); i++) {
-        lazy_folder.files(i).Unpack()->set_name("new_file" + std::to_string(i));
+        lazy_folder.mutable_files(i)->Unpack()->set_name("new_file" + std::to_string(i));
     }
 
     ASSERT_TRUE(folder.ParseFromString(lazy_folder.SerializeAsString()));
@@ -1163,7 +1163,7 @@ FolderLazy::~FolderLazy() {
 
 inline void FolderLazy::SharedDtor() {
   GOOGLE_DCHECK(GetArenaForAllocation() == nullptr);
-  _impl_.files_.~RepeatedPtrField();
+  _impl_.files_.~RepeatedLazyField();
   _impl_.name_.Destroy();
   _impl_.path_.Destroy();
 }
@@ -1218,11 +1218,7 @@ const char* FolderLazy::_InternalParse(const char* ptr, ::_pbi::ParseContext* ct
           ptr -= 1;
           do {
             ptr += 1;
-            if (ctx->IsDerivedFromReleasableBufferStream()) {
-              _internal_add_files()->_InternalParse(ctx->GetBinaryMessageAsBuffersArray(&ptr));
-            } else {
-              _internal_add_files()->_InternalParse(ctx->GetBinaryMessage(&ptr));
-            }
+            ptr = _impl_.files_.InternalParseElement(ptr, ctx);
             CHK_(ptr);
             if (!ctx->DataAvailable(ptr)) break;
           } while (::PROTOBUF_NAMESPACE_ID::internal::ExpectTag<18>(ptr));
@@ -1293,12 +1289,7 @@ failure:
   }
 
   // repeated .protobuf_unittest.File Files = 2 [lazy_pack = true];
-  for (unsigned i = 0,
-      n = static_cast<unsigned>(this->_internal_files_size()); i < n; i++) {
-    const auto& repfield = this->_internal_files(i);
-    target = ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::
-        InternalWriteMessage(2, repfield, repfield.GetCachedSize(), target, stream);
-  }
+  target = this->_impl_.files_.InternalSerialize(2, target, stream);
 
   // optional string Path = 3;
   if (_internal_has_path()) {
@@ -1335,10 +1326,7 @@ failure:
 
   // repeated .protobuf_unittest.File Files = 2 [lazy_pack = true];
   total_size += 1UL * this->_internal_files_size();
-  for (const auto& msg : this->_impl_.files_) {
-    total_size +=
-      ::PROTOBUF_NAMESPACE_ID::internal::WireFormatLite::MessageSize(msg);
-  }
+  total_size += this->_impl_.files_.ElementsByteSizeLong();
 
   cached_has_bits = _impl_._has_bits_[0];
   if (cached_has_bits & 0x00000007u) {
@@ -1581,11 +1569,7 @@ const char* BigProtoLazy::_InternalParse(const char* ptr, ::_pbi::ParseContext*
       // optional .protobuf_unittest.Folder Folder = 2 [lazy_pack = true];
       case 2:
         if (PROTOBUF_PREDICT_TRUE(static_cast<::uint8_t>(tag) == 18)) {
-          if (ctx->IsDerivedFromReleasableBufferStream()) {
-            _internal_mutable_folder()->_InternalParse(ctx->GetBinaryMessageAsBuffersArray(&ptr));
-          } else {
-            _internal_mutable_folder()->_InternalParse(ctx->GetBinaryMessage(&ptr));
-          }
+          ptr = _internal_mutable_folder()->_InternalParseLengthDelimited(ptr, ctx);
           CHK_(ptr);
         } else {
           goto handle_unusual;
@@ -2584,11 +2568,7 @@ const char* LazyFolderLazyWraper::_InternalParse(const char* ptr, ::_pbi::ParseC
       // optional .protobuf_unittest.FolderLazy Folder = 2 [lazy_pack = true];
       case 2:
         if (PROTOBUF_PREDICT_TRUE(static_cast<::uint8_t>(tag) == 18)) {
-          if (ctx->IsDerivedFromReleasableBufferStream()) {
-            _internal_mutable_folder()->_InternalParse(ctx->GetBinaryMessageAsBuffersArray(&ptr));
-          } else {
-            _internal_mutable_folder()->_InternalParse(ctx->GetBinaryMessage(&ptr));
-          }
+          ptr = _internal_mutable_folder()->_InternalParseLengthDelimited(ptr, ctx);
           CHK_(ptr);
         } else {
           goto handle_unusual;
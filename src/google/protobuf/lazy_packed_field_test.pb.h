@@ -655,7 +655,7 @@ class FolderLazy final :
   public:
   void clear_files();
   ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>* mutable_files(int index);
-  ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File> >*
+  ::PROTOBUF_NAMESPACE_ID::RepeatedLazyField<::protobuf_unittest::File>*
       mutable_files();
   private:
   const ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>& _internal_files(int index) const;
@@ -663,7 +663,7 @@ class FolderLazy final :
   public:
   const ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>& files(int index) const;
   ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>* add_files();
-  const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File> >&
+  const ::PROTOBUF_NAMESPACE_ID::RepeatedLazyField<::protobuf_unittest::File>&
       files() const;
 
   // optional string Name = 1;
@@ -725,7 +725,7 @@ class FolderLazy final :
   struct Impl_ {
     ::PROTOBUF_NAMESPACE_ID::internal::HasBits<1> _has_bits_;
     mutable ::PROTOBUF_NAMESPACE_ID::internal::CachedSize _cached_size_;
-    ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File> > files_;
+    ::PROTOBUF_NAMESPACE_ID::RepeatedLazyField<::protobuf_unittest::File> files_;
     ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr name_;
     ::PROTOBUF_NAMESPACE_ID::internal::ArenaStringPtr path_;
     ::uint32_t bytesize_;
@@ -2051,7 +2051,7 @@ inline ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>* FolderLaz
   // @@protoc_insertion_point(field_mutable:protobuf_unittest.FolderLazy.Files)
   return _impl_.files_.Mutable(index);
 }
-inline ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File> >*
+inline ::PROTOBUF_NAMESPACE_ID::RepeatedLazyField<::protobuf_unittest::File>*
 FolderLazy::mutable_files() {
   // @@protoc_insertion_point(field_mutable_list:protobuf_unittest.FolderLazy.Files)
   return &_impl_.files_;
@@ -2071,7 +2071,7 @@ inline ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File>* FolderLaz
   // @@protoc_insertion_point(field_add:protobuf_unittest.FolderLazy.Files)
   return _add;
 }
-inline const ::PROTOBUF_NAMESPACE_ID::RepeatedPtrField< ::PROTOBUF_NAMESPACE_ID::TLazyField<::protobuf_unittest::File> >&
+inline const ::PROTOBUF_NAMESPACE_ID::RepeatedLazyField<::protobuf_unittest::File>&
 FolderLazy::files() const {
   // @@protoc_insertion_point(field_list:protobuf_unittest.FolderLazy.Files)
   return _impl_.files_;
@@ -486,6 +486,7 @@ class Map {
           num_buckets_(internal::kGlobalEmptyTableSize),
           seed_(0),
           index_of_first_non_null_(internal::kGlobalEmptyTableSize),
+          min_num_buckets_(kMinTableSize),
           table_(const_cast<void**>(internal::kGlobalEmptyTable)),
           alloc_(arena) {}
 
@@ -502,6 +503,7 @@ class Map {
 
    private:
     enum { kMinTableSize = 8 };
+    enum { kMaxMapLoadTimes16 = 12 };  // controls RAM vs CPU tradeoff
 
     // Linked-list nodes, as one would expect for a chaining hash table.
     struct Node {
@@ -660,6 +662,8 @@ class Map {
       std::swap(num_buckets_, other->num_buckets_);
       std::swap(seed_, other->seed_);
       std::swap(index_of_first_non_null_, other->index_of_first_non_null_);
+      // A reservation belongs to the map it was made on, not to its elements.
+      min_num_buckets_ = other->min_num_buckets_ = kMinTableSize;
       std::swap(table_, other->table_);
       std::swap(alloc_, other->alloc_);
     }
@@ -698,6 +702,8 @@ class Map {
       }
       num_elements_ = 0;
       index_of_first_non_null_ = num_buckets_;
+      // Let the next insertion shrink the table again.
+      min_num_buckets_ = kMinTableSize;
     }
 
     const hasher& hash_function() const { return *this; }
@@ -708,6 +714,37 @@ class Map {
     size_type size() const { return num_elements_; }
     bool empty() const { return size() == 0; }
 
+    // Grows the table so that `n` elements fit without any further rehashing
+    // and keeps it from shrinking below that size until clear() or Swap().
+    void Reserve(size_type n) {
+      if (n == 0) return;
+      size_type new_num_buckets = kMinTableSize;
+      while (n >= new_num_buckets * kMaxMapLoadTimes16 / 16 &&
+             new_num_buckets <= max_size() / 2) {
+        new_num_buckets *= 2;
+      }
+      min_num_buckets_ = (std::max)(min_num_buckets_, new_num_buckets);
+      if (new_num_buckets > num_buckets_) Resize(new_num_buckets);
+    }
+
+    // Reserve()s room for one bulk insertion, so that its nodes are not
+    // rehashed log(n) times, and restores the previous floor once it is
+    // done: a large assignment or merge must not pin a large table.
+    class BulkInsertScope {
+     public:
+      BulkInsertScope(InnerMap* map, size_type n)
+          : map_(map), min_num_buckets_(map->min_num_buckets_) {
+        map_->Reserve(n);
+      }
+      ~BulkInsertScope() { map_->min_num_buckets_ = min_num_buckets_; }
+      BulkInsertScope(const BulkInsertScope&) = delete;
+      BulkInsertScope& operator=(const BulkInsertScope&) = delete;
+
+     private:
+      InnerMap* map_;
+      size_type min_num_buckets_;
+    };
+
     template <typename K>
     iterator find(const K& k) {
       return iterator(FindHelper(k).first);
@@ -974,7 +1011,6 @@ class Map {
     // policy that sometimes we resize down as well as up, clients can easily
     // keep O(size()) = O(number of buckets) if they want that.
     bool ResizeIfLoadIsOutOfRange(size_type new_size) {
-      const size_type kMaxMapLoadTimes16 = 12;  // controls RAM vs CPU tradeoff
       const size_type hi_cutoff = num_buckets_ * kMaxMapLoadTimes16 / 16;
       const size_type lo_cutoff = hi_cutoff / 4;
       // We don't care how many elements are in trees.  If a lot are,
@@ -986,7 +1022,7 @@ class Map {
           return true;
         }
       } else if (PROTOBUF_PREDICT_FALSE(new_size <= lo_cutoff &&
-                                        num_buckets_ > kMinTableSize)) {
+                                        num_buckets_ > min_num_buckets_)) {
         size_type lg2_of_size_reduction_factor = 1;
         // It's possible we want to shrink a lot here... size() could even be 0.
         // So, estimate how much to shrink by making sure we don't shrink so
@@ -997,7 +1033,7 @@ class Map {
           ++lg2_of_size_reduction_factor;
         }
         size_type new_num_buckets = std::max<size_type>(
-            kMinTableSize, num_buckets_ >> lg2_of_size_reduction_factor);
+            min_num_buckets_, num_buckets_ >> lg2_of_size_reduction_factor);
         if (new_num_buckets != num_buckets_) {
           Resize(new_num_buckets);
           return true;
@@ -1011,7 +1047,7 @@ class Map {
       if (num_buckets_ == internal::kGlobalEmptyTableSize) {
         // This is the global empty array.
         // Just overwrite with a new one. No need to transfer or free anything.
-        num_buckets_ = index_of_first_non_null_ = kMinTableSize;
+        num_buckets_ = index_of_first_non_null_ = TableSize(new_num_buckets);
         table_ = CreateEmptyTable(num_buckets_);
         seed_ = Seed();
         return;
@@ -1205,6 +1241,7 @@ class Map {
     size_type num_buckets_;
     size_type seed_;
     size_type index_of_first_non_null_;
+    size_type min_num_buckets_;  // the table never shrinks below this
     void** table_;  // an array with num_buckets_ entries
     Allocator alloc_;
   };  // end of class InnerMap
@@ -1298,6 +1335,10 @@ class Map {
   size_type size() const { return elements_.size(); }
   bool empty() const { return size() == 0; }
 
+  // Prepares the map to hold at least `n` elements without rehashing.  The
+  // table keeps that size until clear() or swap().
+  void reserve(size_type n) { elements_.Reserve(n); }
+
   // Element access
   template <typename K = key_type>
   T& operator[](const key_arg<K>& key) {
@@ -1389,6 +1430,11 @@ class Map {
   }
   template <class InputIt>
   void insert(InputIt first, InputIt last) {
+    typename InnerMap::BulkInsertScope bulk_insert(
+        &elements_,
+        RangeSizeAfterInsert(
+            first, last,
+            typename std::iterator_traits<InputIt>::iterator_category{}));
     for (; first != last; ++first) {
       auto&& pair = *first;
       try_emplace(pair.first, pair.second);
@@ -1463,6 +1509,20 @@ class Map {
   struct Rank1 {};
   struct Rank0 : Rank1 {};
 
+  // Returns the size to reserve before inserting a range: an upper bound on
+  // the size afterwards when the length of the range is known without
+  // consuming it, and 0 (nothing to reserve) otherwise.
+  template <class InputIt>
+  size_type RangeSizeAfterInsert(const InputIt& first, const InputIt& last,
+                                 std::forward_iterator_tag) const {
+    return size() + static_cast<size_type>(std::distance(first, last));
+  }
+  template <class InputIt>
+  size_type RangeSizeAfterInsert(const InputIt&, const InputIt&,
+                                 std::input_iterator_tag) const {
+    return 0;
+  }
+
   // We try to construct `init_type` from `Args` with a fall back to
   // `value_type`. The latter is less desired as it unconditionally makes a copy
   // of `value_type::first`.
@@ -99,6 +99,10 @@ class MapFieldLite {
   int size() const { return static_cast<int>(map_.size()); }
   void Clear() { return map_.clear(); }
   void MergeFrom(const MapFieldLite& other) {
+    // Keys may overlap, so this may overshoot; the table can shrink again on
+    // later insertions.
+    typename Map<Key, T>::InnerMap::BulkInsertScope bulk_insert(
+        &map_.elements_, map_.size() + other.map_.size());
     for (typename Map<Key, T>::const_iterator it = other.map_.begin();
          it != other.map_.end(); ++it) {
       map_[it->first] = it->second;
@@ -254,6 +254,15 @@ class PROTOBUF_EXPORT MessageLite {
   // required fields.
   PROTOBUF_ATTRIBUTE_REINITIALIZES bool ParsePartialFromFileDescriptor(
       int file_descriptor);
+  // Like ParseFromFileDescriptor(), but memory-maps the file (from the
+  // current offset to its end) instead of reading it through a buffer.  See
+  // io::MmapInputStream.  Only works for regular files.
+  PROTOBUF_ATTRIBUTE_REINITIALIZES bool ParseFromMappedFile(
+      int file_descriptor);
+  // Like ParseFromMappedFile(), but accepts messages that are missing
+  // required fields.
+  PROTOBUF_ATTRIBUTE_REINITIALIZES bool ParsePartialFromMappedFile(
+      int file_descriptor);
   // Parse a protocol buffer from a C++ istream.  If successful, the entire
   // input will be consumed.
   PROTOBUF_ATTRIBUTE_REINITIALIZES bool ParseFromIstream(std::istream* input);
@@ -30,6 +30,16 @@
 
 #include "google/protobuf/parse_context.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+
+#include "absl/numeric/bits.h"
 #include "absl/strings/string_view.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
@@ -235,8 +245,43 @@ const char* EpsCopyInputStream::AppendStringFallback(const char* ptr, int size,
                     [str](const char* p, int s) { str->append(p, s); });
 }
 
-bool EpsCopyInputStream::IsDerivedFromReleasableBufferStream() const {
-  return dynamic_cast<io::IstreamInputStream*>(zcis_) != nullptr;
+TLazyRefBuffer EpsCopyInputStream::ShareBuffer(const char* ptr,
+                                               int max_size) const {
+  bool in_patch = ptr >= buffer_ && ptr < buffer_ + sizeof(buffer_);
+  // Outside of the patch buffer, the current chunk extends kSlopBytes past
+  // buffer_end_.
+  int available =
+      static_cast<int>(buffer_end_ - ptr) + (in_patch ? 0 : kSlopBytes);
+  available = std::min({available, BytesUntilLimit(ptr), max_size});
+  GOOGLE_DCHECK_GT(available, 0);
+
+  TLazyRefBuffer result;
+  if (!in_patch) {
+    if (zcis_ != nullptr && zcis_->AllowsSharedBuffers()) {
+      io::RefCountBuffer shared = zcis_->GetSharedBuffer();
+      auto* data = reinterpret_cast<const char*>(shared.data.get());
+      if (data != nullptr && ptr >= data &&
+          ptr + available <= data + shared.size) {
+        result = std::move(shared);
+        result.start_offset = ptr - data;
+        result.end_offset = result.size - result.start_offset - available;
+        return result;
+      }
+    } else if (AliasingEnabled()) {
+      // The caller owns the input and guarantees its lifetime, so the
+      // returned handle does not own anything.
+      result.data = std::shared_ptr<uint8_t[]>(
+          std::shared_ptr<uint8_t[]>(),
+          reinterpret_cast<uint8_t*>(const_cast<char*>(ptr)));
+      result.size = available;
+      return result;
+    }
+  }
+
+  result.data.reset(new uint8_t[available]);
+  std::memcpy(result.data.get(), ptr, available);
+  result.size = available;
+  return result;
 }
 
 
@@ -283,54 +328,47 @@ std::string ParseContext::ReadAllDataAsString(const char** ptr) {
 
 
 std::string ParseContext::GetBinaryMessage(const char** ptr) {
-  size_t size = google::protobuf::internal::ReadSize(ptr);
-   
+  int size = ReadSize(ptr);
   std::string buff;
-  buff.reserve(size);
+  if (*ptr != nullptr) *ptr = ReadString(*ptr, size, &buff);
+  return buff;
+}
 
-  while (buff.size() < size) {
-    Done(ptr);
-    int read_bytes = std::min((size_t)MaximumReadSize(*ptr), size - buff.size());
-    buff.insert(buff.end(), *ptr, *ptr + read_bytes);
-    *ptr += read_bytes;
-  }
+namespace {
 
-  return buff;
+int SharedSize(const TLazyRefBuffer& buffer) {
+  return static_cast<int>(buffer.size - buffer.start_offset -
+                          buffer.end_offset);
 }
 
-std::vector<TLazyRefBuffer> ParseContext::ReadAllDataAsBuffersArray(const char** ptr) {
-  std::vector<TLazyRefBuffer> result;
+}  // namespace
 
-  while(!Done(ptr)) {
-    io::RefCountBuffer buffer = GetSharedBuffer(*ptr);
-    TLazyRefBuffer list_buffer;
-    list_buffer = buffer;
-    list_buffer.start_offset = (reinterpret_cast<const uint8_t*>(*ptr) - buffer.data.get());
-    result.push_back(list_buffer);
-    *ptr = reinterpret_cast<const char*>(buffer.data.get()) + buffer.size;
+std::vector<TLazyRefBuffer> ParseContext::ReadAllDataAsBuffersArray(
+    const char** ptr) {
+  std::vector<TLazyRefBuffer> result;
+  while (!Done(ptr)) {
+    result.push_back(ShareBuffer(*ptr, INT_MAX));
+    *ptr += SharedSize(result.back());
   }
-
   return result;
 }
 
-std::vector<TLazyRefBuffer> ParseContext::GetBinaryMessageAsBuffersArray(const char** ptr) {
+std::vector<TLazyRefBuffer> ParseContext::GetBinaryMessageAsBuffersArray(
+    const char** ptr) {
   std::vector<TLazyRefBuffer> result;
-  size_t size = google::protobuf::internal::ReadSize(ptr);
-  size_t get_data_size = 0;
-  while (get_data_size != size) {
-    Done(ptr);
-    io::RefCountBuffer buffer = GetSharedBuffer(*ptr);
-    TLazyRefBuffer list_buffer;
-    list_buffer = buffer;
-    list_buffer.start_offset = (reinterpret_cast<const uint8_t*>(*ptr) - buffer.data.get());
-    if (buffer.size - list_buffer.start_offset > (size - get_data_size)) {
-      list_buffer.end_offset = buffer.size - list_buffer.start_offset - (size - get_data_size);
+  int size = ReadSize(ptr);
+  if (*ptr == nullptr) return result;
+  while (size > 0) {
+    if (Done(ptr)) {
+      // The message is truncated.
+      *ptr = nullptr;
+      break;
     }
-    get_data_size += buffer.size - list_buffer.start_offset - list_buffer.end_offset;
-    result.push_back(list_buffer);
-    *ptr = reinterpret_cast<const char*>(buffer.data.get()) + buffer.size - list_buffer.end_offset;
+    result.push_back(ShareBuffer(*ptr, size));
+    int shared = SharedSize(result.back());
+    *ptr += shared;
+    size -= shared;
   }
-
   return result;
 }
 
@@ -397,6 +435,29 @@ std::pair<const char*, uint32_t> VarintParseSlow32(const char* p,
   return {nullptr, 0};
 }
 
+int CountVarintsInArray(const char* ptr, const char* end) {
+  int count = 0;
+#if defined(__SSE2__)
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+    // movemask gathers the continuation bit of every byte.
+    count += 16 - absl::popcount(
+                      static_cast<uint32_t>(_mm_movemask_epi8(chunk)));
+    ptr += 16;
+  }
+#endif  // __SSE2__
+  while (end - ptr >= 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, ptr, sizeof(chunk));
+    count += 8 - absl::popcount(chunk & 0x8080808080808080);
+    ptr += 8;
+  }
+  for (; ptr < end; ++ptr) {
+    count += static_cast<uint8_t>(*ptr) < 0x80;
+  }
+  return count;
+}
+
 std::pair<const char*, uint64_t> VarintParseSlow64(const char* p,
                                                    uint32_t res32) {
   uint64_t res = res32;
@@ -209,6 +209,15 @@ class PROTOBUF_EXPORT EpsCopyInputStream {
                                                  RepeatedField<T>* out);
   template <typename Add>
   PROTOBUF_NODISCARD const char* ReadPackedVarint(const char* ptr, Add add);
+  // Like ReadPackedVarint(ptr, add) but calls `reserve(n)` before decoding
+  // each flat chunk of the payload, where `n` is the number of varints that
+  // end inside that chunk. It is a lower bound: a varint straddling the end
+  // of a buffer, and the few bytes decoded from the slop region, are handed
+  // to `add` without being counted. This lets callers size the destination
+  // about once per chunk instead of growing it element by element.
+  template <typename Add, typename Reserve>
+  PROTOBUF_NODISCARD const char* ReadPackedVarint(const char* ptr, Add add,
+                                                  Reserve reserve);
 
   uint32_t LastTag() const { return last_tag_minus_1_ + 1; }
   bool ConsumeEndGroup(uint32_t start_tag) {
@@ -237,18 +246,21 @@ class PROTOBUF_EXPORT EpsCopyInputStream {
   // call Done for further checks.
   bool DataAvailable(const char* ptr) { return ptr < limit_end_; }
 
-  bool IsDerivedFromReleasableBufferStream() const;
-
-  io::RefCountBuffer GetSharedBuffer(const char* p) const {
-    if (p >= buffer_ && p <= buffer_ + 32) {
-      io::RefCountBuffer buffer;
-      buffer.data.reset(new uint8_t[kSlopBytes + size_]);
-      memcpy(buffer.data.get(), buffer_, kSlopBytes + size_);
-      buffer.size = kSlopBytes + size_;
-    }
-    return zcis_->GetSharedBuffer();
+  // Returns true if lazily parsed fields can refer to the input instead of
+  // copying out of it: either the underlying stream hands out shared buffers,
+  // or aliasing is enabled and the caller guarantees the input outlives the
+  // parsed message.
+  bool CanShareBuffers() const {
+    return AliasingEnabled() ||
+           (zcis_ != nullptr && zcis_->AllowsSharedBuffers());
   }
 
+  // Returns a buffer holding the next (at most `max_size`) contiguous bytes
+  // starting at `ptr`, which must not be at a limit (i.e. Done() returned
+  // false). The bytes are shared with the input if CanShareBuffers() is true
+  // and copied otherwise, as they are when `ptr` is in the patch buffer.
+  TLazyRefBuffer ShareBuffer(const char* ptr, int max_size) const;
+
  protected:
   // Returns true is limit (either an explicit limit or end of stream) is
   // reached. It aligns *ptr across buffer seams.
@@ -969,9 +981,26 @@ const char* EpsCopyInputStream::ReadPackedFixed(const char* ptr, int size,
   return ptr;
 }
 
+// Returns the number of varints that end in [ptr, end), that is the number of
+// bytes in the range without the continuation bit set. Uses SSE2 when
+// available and a portable 8-bytes-at-a-time loop otherwise.
+PROTOBUF_EXPORT int CountVarintsInArray(const char* ptr, const char* end);
+
 template <typename Add>
 const char* ReadPackedVarintArray(const char* ptr, const char* end, Add add) {
   while (ptr < end) {
+    // Packed arrays are dominated by small values. Check eight bytes at once
+    // and, if none of them has the continuation bit set, emit them directly
+    // without going through the generic varint decoder.
+    if (end - ptr >= 8) {
+      uint64_t chunk;
+      std::memcpy(&chunk, ptr, sizeof(chunk));
+      if ((chunk & 0x8080808080808080) == 0) {
+        for (int i = 0; i < 8; i++) add(static_cast<uint8_t>(ptr[i]));
+        ptr += 8;
+        continue;
+      }
+    }
     uint64_t varint;
     ptr = VarintParse(ptr, &varint);
     if (ptr == nullptr) return nullptr;
@@ -980,12 +1009,27 @@ const char* ReadPackedVarintArray(const char* ptr, const char* end, Add add) {
   return ptr;
 }
 
+// Reserve callback used when the caller has nothing to pre-size; it lets
+// ReadPackedVarint skip the counting pass altogether.
+struct NoReservePackedVarint {
+  void operator()(int) const {}
+};
+
 template <typename Add>
 const char* EpsCopyInputStream::ReadPackedVarint(const char* ptr, Add add) {
+  return ReadPackedVarint(ptr, add, NoReservePackedVarint{});
+}
+
+template <typename Add, typename Reserve>
+const char* EpsCopyInputStream::ReadPackedVarint(const char* ptr, Add add,
+                                                 Reserve reserve) {
+  constexpr bool kCount =
+      !std::is_same<Reserve, NoReservePackedVarint>::value;
   int size = ReadSize(&ptr);
   GOOGLE_PROTOBUF_PARSER_ASSERT(ptr);
   int chunk_size = static_cast<int>(buffer_end_ - ptr);
   while (size > chunk_size) {
+    if (kCount) reserve(CountVarintsInArray(ptr, buffer_end_));
     ptr = ReadPackedVarintArray(ptr, buffer_end_, add);
     if (ptr == nullptr) return nullptr;
     int overrun = static_cast<int>(ptr - buffer_end_);
@@ -1012,6 +1056,7 @@ const char* EpsCopyInputStream::ReadPackedVarint(const char* ptr, Add add) {
     chunk_size = static_cast<int>(buffer_end_ - ptr);
   }
   auto end = ptr + size;
+  if (kCount) reserve(CountVarintsInArray(ptr, end));
   ptr = ReadPackedVarintArray(ptr, end, add);
   return end == ptr ? ptr : nullptr;
 }
@@ -33,6 +33,13 @@
 
 #include "google/protobuf/util/delimited_message_util.h"
 
+#include <climits>
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/stubs/logging.h"
 #include "google/protobuf/io/coded_stream.h"
 
 namespace google {
@@ -124,6 +131,197 @@ bool SerializeDelimitedToCodedStream(const MessageLite& message,
   return true;
 }
 
+DelimitedBatchWriter::DelimitedBatchWriter(io::ZeroCopyOutputStream* output)
+    : output_(output) {}
+
+DelimitedBatchWriter::~DelimitedBatchWriter() = default;
+
+bool DelimitedBatchWriter::Write(
+    absl::Span<const MessageLite* const> messages) {
+  sizes_.clear();
+  sizes_.reserve(messages.size());
+  size_t total = 0;
+  for (const MessageLite* message : messages) {
+    size_t size = message->ByteSizeLong();
+    if (size > INT_MAX) return false;
+    sizes_.push_back(static_cast<uint32_t>(size));
+    total += io::CodedOutputStream::VarintSize32(static_cast<uint32_t>(size)) +
+             size;
+  }
+
+  io::CodedOutputStream coded_output(output_);
+  if (total <= INT_MAX) {
+    uint8_t* buffer = coded_output.GetDirectBufferForNBytesAndAdvance(
+        static_cast<int>(total));
+    if (buffer != nullptr) {
+      // Optimization: The whole batch fits in one buffer, so use the faster
+      // direct-to-array serialization path.
+      uint8_t* ptr = buffer;
+      for (size_t i = 0; i < messages.size(); ++i) {
+        ptr = io::CodedOutputStream::WriteVarint32ToArray(sizes_[i], ptr);
+        ptr = messages[i]->SerializeWithCachedSizesToArray(ptr);
+      }
+      GOOGLE_DCHECK_EQ(static_cast<size_t>(ptr - buffer), total);
+      return !coded_output.HadError();
+    }
+  }
+
+  // The batch spans several buffers; write message by message, reusing the
+  // sizes cached above.
+  for (size_t i = 0; i < messages.size(); ++i) {
+    coded_output.WriteVarint32(sizes_[i]);
+    uint8_t* buffer = coded_output.GetDirectBufferForNBytesAndAdvance(
+        static_cast<int>(sizes_[i]));
+    if (buffer != nullptr) {
+      messages[i]->SerializeWithCachedSizesToArray(buffer);
+    } else {
+      messages[i]->SerializeWithCachedSizes(&coded_output);
+    }
+    if (coded_output.HadError()) return false;
+  }
+  return true;
+}
+
+// A record that has been read from the stream and handed to the executor.
+struct DelimitedStreamReader::Pending {
+  std::string body;
+  size_t size = 0;
+  Record record;
+  // Guarded by State::mu.
+  bool done = false;
+  bool ok = false;
+};
+
+// Synchronization between ReadAll() and the parse tasks.  Shared with the
+// tasks so that it outlives the last one to signal.
+struct DelimitedStreamReader::State {
+  absl::Mutex mu;
+  absl::CondVar cv;
+};
+
+DelimitedStreamReader::DelimitedStreamReader(const MessageLite* prototype,
+                                             io::ZeroCopyInputStream* input,
+                                             Executor executor)
+    : DelimitedStreamReader(prototype, input, std::move(executor), Options()) {
+}
+
+DelimitedStreamReader::DelimitedStreamReader(const MessageLite* prototype,
+                                             io::ZeroCopyInputStream* input,
+                                             Executor executor,
+                                             const Options& options)
+    : prototype_(prototype),
+      input_(input),
+      executor_(std::move(executor)),
+      options_(options) {}
+
+DelimitedStreamReader::~DelimitedStreamReader() = default;
+
+bool DelimitedStreamReader::ReadAll(
+    const std::function<void(Record record)>& callback) {
+  // CodedInputStream positions are ints; start a fresh one well before they
+  // could overflow on long streams.
+  constexpr int kMaxCodedStreamPosition = 1 << 30;
+
+  auto state = std::make_shared<State>();
+  // Records in stream order, up to options_.max_records_in_flight of them.
+  std::deque<std::unique_ptr<Pending>> pending;
+  size_t bytes_in_flight = 0;
+  bool ok = true;
+  bool parse_failed = false;
+
+  // Waits for the next deliverable record, removes it from `pending` and
+  // delivers it unless an earlier record failed to parse.  Returns false if
+  // this record failed to parse.
+  auto deliver_one = [&]() -> bool {
+    std::unique_ptr<Pending> next;
+    {
+      absl::MutexLock lock(&state->mu);
+      while (next == nullptr) {
+        if (options_.ordered) {
+          if (pending.front()->done) {
+            next = std::move(pending.front());
+            pending.pop_front();
+          }
+        } else {
+          for (auto it = pending.begin(); it != pending.end(); ++it) {
+            if ((*it)->done) {
+              next = std::move(*it);
+              pending.erase(it);
+              break;
+            }
+          }
+        }
+        if (next == nullptr) state->cv.Wait(&state->mu);
+      }
+    }
+    bytes_in_flight -= next->size;
+    if (!next->ok) {
+      parse_failed = true;
+      return false;
+    }
+    if (!parse_failed) callback(std::move(next->record));
+    return true;
+  };
+
+  std::unique_ptr<io::CodedInputStream> coded;
+  while (ok) {
+    while (!pending.empty() &&
+           (pending.size() >=
+                static_cast<size_t>(options_.max_records_in_flight) ||
+            bytes_in_flight >= options_.max_bytes_in_flight)) {
+      if (!deliver_one()) ok = false;
+    }
+    if (!ok) break;
+
+    if (coded == nullptr ||
+        coded->CurrentPosition() > kMaxCodedStreamPosition) {
+      // Destroy the old stream first; it backs up its unread buffer.
+      coded.reset();
+      coded.reset(new io::CodedInputStream(input_));
+    }
+    int start = coded->CurrentPosition();
+    uint32_t size;
+    if (!coded->ReadVarint32(&size)) {
+      // Fine at a record boundary, truncated otherwise.
+      ok = coded->CurrentPosition() == start;
+      break;
+    }
+    auto p = std::make_unique<Pending>();
+    if (!coded->ReadString(&p->body, static_cast<int>(size))) {
+      ok = false;
+      break;
+    }
+    p->size = size;
+    p->record.index = records_read_++;
+    p->record.arena.reset(new Arena(options_.arena_options));
+    p->record.message = prototype_->New(p->record.arena.get());
+    bytes_in_flight += size;
+
+    Pending* raw = p.get();
+    pending.push_back(std::move(p));
+    auto task = [raw, state] {
+      bool parsed = raw->record.message->ParseFromString(raw->body);
+      std::string().swap(raw->body);
+      absl::MutexLock lock(&state->mu);
+      raw->ok = parsed;
+      raw->done = true;
+      state->cv.Signal();
+    };
+    if (executor_) {
+      executor_(std::move(task));
+    } else {
+      task();
+    }
+  }
+
+  // Wait for everything that was scheduled.  Records read before a stream
+  // error are still delivered.
+  while (!pending.empty()) {
+    if (!deliver_one()) ok = false;
+  }
+  return ok;
+}
+
 }  // namespace util
 }  // namespace protobuf
 }  // namespace google
@@ -33,10 +33,15 @@
 
 #include "google/protobuf/util/delimited_message_util.h"
 
+#include <algorithm>
+#include <deque>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "google/protobuf/testing/googletest.h"
 #include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
 #include "google/protobuf/test_util.h"
 #include "google/protobuf/unittest.pb.h"
 
@@ -111,6 +116,183 @@ TEST(DelimitedMessageUtilTest, FailsAtEndOfStream) {
   }
 }
 
+TEST(DelimitedMessageUtilTest, DelimitedBatchWriter) {
+  std::vector<protobuf_unittest::TestAllTypes> messages(50);
+  std::vector<const MessageLite*> batch;
+  std::string expected;
+  {
+    io::StringOutputStream output(&expected);
+    for (size_t i = 0; i < messages.size(); ++i) {
+      messages[i].set_optional_int32(i);
+      messages[i].set_optional_string(std::string(i * 10, 'x'));
+      batch.push_back(&messages[i]);
+      EXPECT_TRUE(SerializeDelimitedToZeroCopyStream(messages[i], &output));
+    }
+  }
+
+  // Batches both larger and smaller than the stream's buffers.
+  for (int block_size : {16, 1 << 16}) {
+    std::string actual(2 * expected.size(), '\0');
+    io::ArrayOutputStream output(&actual[0], actual.size(), block_size);
+    {
+      DelimitedBatchWriter writer(&output);
+      EXPECT_TRUE(writer.Write(batch));
+      EXPECT_TRUE(writer.Write({}));
+      EXPECT_TRUE(writer.Write(batch));
+    }
+    EXPECT_EQ(actual.size(), output.ByteCount());
+    EXPECT_EQ(expected + expected, actual);
+  }
+}
+
+namespace {
+
+// Minimal fixed-size thread pool to drive DelimitedStreamReader.
+class TestThreadPool {
+ public:
+  explicit TestThreadPool(int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this] { Run(); });
+    }
+  }
+  ~TestThreadPool() {
+    {
+      absl::MutexLock lock(&mu_);
+      stopping_ = true;
+    }
+    for (auto& thread : threads_) thread.join();
+  }
+
+  DelimitedStreamReader::Executor executor() {
+    return [this](std::function<void()> task) {
+      absl::MutexLock lock(&mu_);
+      tasks_.push_back(std::move(task));
+    };
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        absl::MutexLock lock(&mu_);
+        mu_.Await(absl::Condition(
+            +[](TestThreadPool* pool) {
+              return pool->stopping_ || !pool->tasks_.empty();
+            },
+            this));
+        if (tasks_.empty()) return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  absl::Mutex mu_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+std::string WriteDelimitedRecords(int count) {
+  std::stringstream stream;
+  protobuf_unittest::TestAllTypes message;
+  for (int i = 0; i < count; ++i) {
+    message.set_optional_int32(i);
+    message.set_optional_string(std::string(i % 100, 'x'));
+    EXPECT_TRUE(SerializeDelimitedToOstream(message, &stream));
+  }
+  return stream.str();
+}
+
+}  // namespace
+
+TEST(DelimitedMessageUtilTest, DelimitedStreamReaderOrdered) {
+  constexpr int kRecords = 2000;
+  std::string data = WriteDelimitedRecords(kRecords);
+  TestThreadPool pool(4);
+
+  DelimitedStreamReader::Options options;
+  options.max_records_in_flight = 16;
+  options.max_bytes_in_flight = 1024;
+  io::ArrayInputStream input(data.data(), data.size(), 100);
+  DelimitedStreamReader reader(
+      &protobuf_unittest::TestAllTypes::default_instance(), &input,
+      pool.executor(), options);
+  int next = 0;
+  EXPECT_TRUE(reader.ReadAll([&](DelimitedStreamReader::Record record) {
+    EXPECT_EQ(next, record.index);
+    auto* message =
+        static_cast<protobuf_unittest::TestAllTypes*>(record.message);
+    EXPECT_EQ(record.arena.get(), message->GetArena());
+    EXPECT_EQ(next, message->optional_int32());
+    EXPECT_EQ(next % 100, message->optional_string().size());
+    ++next;
+  }));
+  EXPECT_EQ(kRecords, next);
+  EXPECT_EQ(kRecords, reader.records_read());
+}
+
+TEST(DelimitedMessageUtilTest, DelimitedStreamReaderUnordered) {
+  constexpr int kRecords = 2000;
+  std::string data = WriteDelimitedRecords(kRecords);
+  TestThreadPool pool(4);
+
+  DelimitedStreamReader::Options options;
+  options.ordered = false;
+  io::ArrayInputStream input(data.data(), data.size());
+  DelimitedStreamReader reader(
+      &protobuf_unittest::TestAllTypes::default_instance(), &input,
+      pool.executor(), options);
+  std::vector<int> seen;
+  EXPECT_TRUE(reader.ReadAll([&](DelimitedStreamReader::Record record) {
+    auto* message =
+        static_cast<protobuf_unittest::TestAllTypes*>(record.message);
+    EXPECT_EQ(record.index, message->optional_int32());
+    seen.push_back(message->optional_int32());
+  }));
+  std::sort(seen.begin(), seen.end());
+  ASSERT_EQ(kRecords, seen.size());
+  for (int i = 0; i < kRecords; ++i) EXPECT_EQ(i, seen[i]);
+}
+
+TEST(DelimitedMessageUtilTest, DelimitedStreamReaderErrors) {
+  std::string data = WriteDelimitedRecords(10);
+
+  // Inline parsing, truncated in the middle of the last record.
+  {
+    io::ArrayInputStream input(data.data(), data.size() - 1);
+    DelimitedStreamReader reader(
+        &protobuf_unittest::TestAllTypes::default_instance(), &input, nullptr);
+    int delivered = 0;
+    EXPECT_FALSE(reader.ReadAll(
+        [&](DelimitedStreamReader::Record) { ++delivered; }));
+    EXPECT_EQ(9, delivered);
+  }
+
+  // A body that does not parse stops delivery at that record.
+  {
+    std::string corrupt = data;
+    protobuf_unittest::TestAllTypes message;
+    message.set_optional_int32(0);
+    message.set_optional_string("");
+    // Skip the first record and replace the tag of the second one with an
+    // end-group tag, which is invalid at the top level.
+    size_t first = 1 + message.ByteSizeLong();
+    corrupt[first + 1] = 0x0c;
+    TestThreadPool pool(2);
+    io::ArrayInputStream input(corrupt.data(), corrupt.size());
+    DelimitedStreamReader reader(
+        &protobuf_unittest::TestAllTypes::default_instance(), &input,
+        pool.executor());
+    int delivered = 0;
+    EXPECT_FALSE(reader.ReadAll(
+        [&](DelimitedStreamReader::Record) { ++delivered; }));
+    EXPECT_EQ(1, delivered);
+  }
+}
+
 }  // namespace util
 }  // namespace protobuf
 }  // namespace google
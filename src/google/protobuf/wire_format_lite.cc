@@ -710,6 +710,36 @@ static size_t VarintSize64(const T* data, const int n) {
   return sum;
 }
 
+// Sums the varint sizes of `n` values after applying `encode`. Packed arrays
+// are usually dominated by small values, so blocks of eight values are first
+// OR-reduced (which vectorizes well on all compilers) and counted as eight
+// single byte varints when they all fit in seven bits.
+template <typename T, typename Encode>
+static size_t PackedVarintSize(const T* data, const int n, Encode encode) {
+  size_t sum = 0;
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t any = 0;
+    for (int j = 0; j < 8; j++) any |= encode(data[i + j]);
+    if (any < 0x80) {
+      sum += 8;
+      continue;
+    }
+    for (int j = 0; j < 8; j++) {
+      sum += io::CodedOutputStream::VarintSize64(encode(data[i + j]));
+    }
+  }
+  for (; i < n; i++) {
+    sum += io::CodedOutputStream::VarintSize64(encode(data[i]));
+  }
+  return sum;
+}
+
+// Sign extends negative values to ten bytes, as required for int32 and enums.
+static uint64_t SignExtendForVarint(int32_t x) {
+  return static_cast<uint64_t>(static_cast<int64_t>(x));
+}
+
 // GCC does not recognize the vectorization opportunity
 // and other platforms are untested, in those cases using the optimized
 // varint size routine for each element is faster.
@@ -735,39 +765,22 @@ size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
 #else  // !(defined(__SSE4_1__) && defined(__clang__))
 
 size_t WireFormatLite::Int32Size(const RepeatedField<int32_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += Int32Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(value.data(), value.size(), SignExtendForVarint);
 }
 
 size_t WireFormatLite::UInt32Size(const RepeatedField<uint32_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += UInt32Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(value.data(), value.size(),
+                          [](uint32_t x) -> uint64_t { return x; });
 }
 
 size_t WireFormatLite::SInt32Size(const RepeatedField<int32_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += SInt32Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(
+      value.data(), value.size(),
+      [](int32_t x) -> uint64_t { return ZigZagEncode32(x); });
 }
 
 size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += EnumSize(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(value.data(), value.size(), SignExtendForVarint);
 }
 
 #endif
@@ -793,30 +806,19 @@ size_t WireFormatLite::SInt64Size(const RepeatedField<int64_t>& value) {
 #else
 
 size_t WireFormatLite::Int64Size(const RepeatedField<int64_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += Int64Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(
+      value.data(), value.size(),
+      [](int64_t x) { return static_cast<uint64_t>(x); });
 }
 
 size_t WireFormatLite::UInt64Size(const RepeatedField<uint64_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += UInt64Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(value.data(), value.size(),
+                          [](uint64_t x) { return x; });
 }
 
 size_t WireFormatLite::SInt64Size(const RepeatedField<int64_t>& value) {
-  size_t out = 0;
-  const int n = value.size();
-  for (int i = 0; i < n; i++) {
-    out += SInt64Size(value.Get(i));
-  }
-  return out;
+  return PackedVarintSize(value.data(), value.size(),
+                          [](int64_t x) { return ZigZagEncode64(x); });
 }
 
 #endif